@@ -0,0 +1,634 @@
+#!/usr/bin/env python3
+"""
+Multiplexed MJPEG sender for Lilka.
+
+Reads frames from stdin and sends them to one or more receivers over the
+multiplexed protocol, interleaving control pings between video chunks and
+reporting control-message latency under load.
+
+Sources:
+  mjpeg  - raw MJPEG stream (GStreamer jpegenc ! fdsink), sent as-is
+  camera - camera MJPEG (v4l2src ! image/jpeg ! fdsink): frames that fit the
+           display pass through, larger ones are scaled in the DCT domain
+  raw    - raw RGB frames (video/x-raw,format=RGB ! fdsink), encoded here;
+           with --tiles each tile gets the cheapest codec for its content,
+           with --layers each receiver gets the best quality (and resolution)
+           it sustains; the receiver follows size changes on any frame
+  --scene-cut - raw source: encode hard cuts cheaply (lower quality or half
+           resolution) and bring detail back over the next frames
+  --denoise - motion-adaptive temporal denoise for noisy camera and capture
+           card sources (raw, or camera frames, which are then re-encoded)
+  --file - a video file, transcoded once into a cached MJPEG clip and then
+           looped with timestamp pacing and no per-frame encoding
+
+With --zerocopy each frame is copied once into a shared buffer that every
+receiver's connection sends from with MSG_ZEROCOPY, instead of being copied
+per receiver and per chunk; --bench-fanout N measures it against N local
+receivers.
+
+With --relay the first receiver forwards every frame to further receivers
+(a chain, or a binary tree with --relay-fanout 2), so the host sends each
+frame once however many screens there are.
+
+With --probe the link goodput and device decode speed are measured right
+after connecting and seed the initial quality (and frame rate for --file);
+--probe-only prints the chosen QUALITY= and FPS= for stream.sh and exits.
+
+Usage: gst-launch-1.0 -q ... ! jpegenc ! fdsink fd=1 | ./lilka_sender.py <IP>[:PORT] ...
+       ./lilka_sender.py <IP> --relay <IP2> --relay <IP3> ...
+       ./lilka_sender.py <IP> --probe-only [--max-fps 30]
+       ./lilka_sender.py <IP> --file promo.mp4 [--fps 15] [--quality 50]
+       ./lilka_sender.py --classify-corpus <DIR> [--quality 50]
+       ./lilka_sender.py --bench-layers <DIR> --layers 30,50,80
+       ./lilka_sender.py --bench-camera <DIR|FILE.mjpeg> [--quality 50]
+       ./lilka_sender.py --bench-denoise <DIR> [--bench-reference <CLEAN_DIR>]
+       ./lilka_sender.py --bench-scene-cut <DIR> [--scene-cut resolution]
+       ./lilka_sender.py --bench-fanout 16
+"""
+
+import argparse
+import os
+import sys
+import threading
+import time
+
+from lilkastream import protocol as proto
+from lilkastream.log import log
+from lilkastream.mjpeg import read_frames
+from lilkastream.mux import FramePool, MuxConnection, fan_out, parse_pace
+from lilkastream.session import Session
+
+IMAGE_EXTENSIONS = (".png", ".jpg", ".jpeg", ".bmp")
+
+
+def control_loop(session, ping_interval, stats_interval):
+    conn = session.conn
+    last_stats = last_tick = time.monotonic()
+    stats_base = tick_base = (0, 0, 0)
+    while not conn.closed:
+        time.sleep(ping_interval)
+        session.ping()
+        now = time.monotonic()
+        counters = (conn.frames_sent, conn.bytes_sent, conn.frames_stale)
+
+        if now - last_tick >= 1.0:
+            sent, stale = counters[0] - tick_base[0], counters[2] - tick_base[2]
+            session.check_stable(last_tick, sent, stale)
+            if session.controller is not None:
+                session.controller.update(now - last_tick, sent, stale)
+            last_tick, tick_base = now, counters
+
+        if now - last_stats >= stats_interval:
+            frames = counters[0] - stats_base[0]
+            session.report(now - last_stats, frames, counters[1] - stats_base[1],
+                           counters[2] - stats_base[2])
+            if session.encoder is not None:
+                mix, predicted_us = session.encoder.take_report()
+                log(f"{session.name}Codec mix: {dict(mix)} | predicted decode "
+                    f"{predicted_us / max(frames, 1) / 1000.0:.1f} ms/frame")
+            last_stats, stats_base = now, counters
+
+
+def live(sessions):
+    return [s for s in sessions if not s.conn.closed]
+
+
+def conns(sessions):
+    return [s.conn for s in sessions]
+
+
+def stream_mjpeg(sessions, pool):
+    for frame in read_frames(sys.stdin.buffer):
+        targets = live(sessions)
+        if not targets:
+            return False
+        fan_out(conns(targets), frame, pool)
+    return True
+
+
+def make_denoiser(args):
+    if not args.denoise:
+        return None
+    from lilkastream.denoise import TemporalDenoiser
+    return TemporalDenoiser(args.denoise)
+
+
+def stream_camera(sessions, args, pool):
+    from lilkastream.camera import CameraTranscoder
+
+    transcoder = CameraTranscoder(args.size, args.quality, denoiser=make_denoiser(args))
+    last_report = time.monotonic()
+    for jpeg in read_frames(sys.stdin.buffer):
+        targets = live(sessions)
+        if not targets:
+            return False
+        frame = transcoder.convert(jpeg)
+        if frame is not None:
+            fan_out(conns(targets), frame, pool)
+        now = time.monotonic()
+        if now - last_report >= args.stats_interval:
+            passed, scaled, failed, cpu_ms = transcoder.take_report()
+            log(f"Camera: {passed} passed through, {scaled} scaled, {failed} unusable,"
+                f" {cpu_ms:.2f} ms CPU/frame")
+            if transcoder.denoiser is not None:
+                log(f"Denoise: {transcoder.denoiser.take_cpu_ms():.2f} ms CPU/frame")
+            last_report = now
+    return True
+
+
+def stream_raw(sessions, args, ladder, pool):
+    from lilkastream.frames import encode_jpeg, read_raw_frames
+
+    width, height = args.size
+    denoiser = make_denoiser(args)
+    budget = None
+    if args.scene_cut:
+        from lilkastream.scenecut import SceneCutBudget
+        budget = SceneCutBudget(args.scene_cut)
+    # The probe may pick a lower rate than the capture delivers
+    credit = 0.0
+    for rgb in read_raw_frames(sys.stdin.buffer, width, height):
+        targets = live(sessions)
+        if not targets:
+            return False
+        # Every captured frame feeds the filter history, sent or not
+        if denoiser is not None:
+            rgb = denoiser.filter(rgb)
+        credit += args.send_fps / args.fps
+        if credit < 1.0:
+            continue
+        credit -= 1.0
+
+        if ladder is not None:
+            groups = {}
+            for session in targets:
+                groups.setdefault(session.controller.layer, []).append(session)
+            layers = ladder.encode(rgb, set(groups))
+            # Receivers on the same layer share its buffer like a single stream
+            for layer, group in groups.items():
+                fan_out(conns(group), layers[layer], pool, meta=layer)
+        elif args.tiles:
+            if budget is not None:
+                cuts = budget.cuts
+                quality, refresh = budget.plan_tiles(rgb, args.quality, len(targets[0].encoder.rects))
+                if budget.cuts != cuts:
+                    log(f"Scene cut: quality {quality} for the cut frame")
+            for session in targets:
+                # A tiled frame only carries changed tiles, so tiles of a frame
+                # that never left the queue must be included in the next one
+                session.encoder.mark_dirty(session.conn.take_pending())
+                if budget is not None:
+                    session.encoder.quality = quality
+                    session.encoder.mark_dirty(refresh)
+                payload, tiled, sent, _ = session.encoder.encode(rgb)
+                session.conn.send_frame(payload, proto.FLAG_TILED if tiled else 0, sent)
+        elif budget is not None:
+            cuts = budget.cuts
+            jpeg = budget.encode(rgb, args.quality)
+            if budget.cuts != cuts:
+                log(f"Scene cut: {len(jpeg) / 1024:.1f} KB cut frame ({args.scene_cut})")
+            fan_out(conns(targets), jpeg, pool)
+        else:
+            fan_out(conns(targets), encode_jpeg(rgb, args.quality), pool)
+    return True
+
+
+def stream_file(sessions, args, pool):
+    from lilkastream.cache import open_clip, play
+
+    try:
+        clip = open_clip(args.file, args.size[0], args.size[1], args.fps, args.quality, args.cache_dir)
+    except (OSError, RuntimeError) as e:
+        log(f"ERROR: {e}")
+        return False
+    log(f"Playing {len(clip)} cached frames ({clip.duration_us / 1e6:.1f} s)"
+        f"{', looping' if not args.once else ''}")
+    return play(clip, lambda: conns(live(sessions)), loop=not args.once, pool=pool)
+
+
+def load_images(root, size):
+    import numpy as np
+    from PIL import Image
+
+    frames = []
+    for path, _, files in sorted(os.walk(root)):
+        for name in sorted(files):
+            if name.lower().endswith(IMAGE_EXTENSIONS):
+                img = Image.open(os.path.join(path, name)).convert("RGB").resize(size)
+                frames.append(np.asarray(img))
+    return frames
+
+
+def classify_corpus(args):
+    """Report codec mix and predicted decode time for directories of images."""
+    from lilkastream.frames import encode_jpeg
+    from lilkastream.tiles import DecodeModel, TileEncoder
+
+    width, height = args.size
+    model = DecodeModel()
+    root = args.classify_corpus
+    corpora = sorted(d for d in os.listdir(root) if os.path.isdir(os.path.join(root, d))) or ["."]
+    for corpus in corpora:
+        frames = load_images(os.path.join(root, corpus), args.size)
+        if not frames:
+            continue
+        encoder = TileEncoder(width, height, args.quality, args.link_kbps, model=model)
+        tile_bytes = full_bytes = 0
+        full_us = 0.0
+        for rgb in frames:
+            payload, _, _, _ = encoder.encode(rgb)
+            tile_bytes += len(payload)
+            full = encode_jpeg(rgb, args.quality)
+            full_bytes += len(full)
+            full_us += model.frame_us(width * height, len(full))
+        mix, tile_us = encoder.take_report()
+        n = len(frames)
+        print(f"{corpus}: {n} frames | mix {dict(mix)} | classes {dict(encoder.classes)}")
+        print(f"  tiles:     {tile_bytes / n / 1024:.1f} KB/frame, decode {tile_us / n / 1000:.1f} ms/frame"
+              f" (total {tile_us / 1000:.0f} ms)")
+        print(f"  full JPEG: {full_bytes / n / 1024:.1f} KB/frame, decode {full_us / n / 1000:.1f} ms/frame"
+              f" (total {full_us / 1000:.0f} ms)")
+    return 0
+
+
+def bench_ladder(args):
+    from lilkastream.simulcast import bench_layers
+
+    frames = load_images(args.bench_layers, args.size)
+    if not frames:
+        log(f"ERROR: no images in {args.bench_layers}")
+        return 1
+    layers = args.layers or [(30, None), (50, None), (80, None)]
+    names = ", ".join(f"{q}@{s[0]}x{s[1]}" if s else str(q) for q, s in layers)
+    print(f"{len(frames)} frames at {args.size[0]}x{args.size[1]}, layers {names}")
+    prev = 0.0
+    for count, cpu_ms, wall_ms in bench_layers(frames, layers, args.fps):
+        print(f"  {count} layer(s): {cpu_ms:.2f} ms CPU/frame (+{cpu_ms - prev:.2f}),"
+              f" {wall_ms:.2f} ms wall/frame, {cpu_ms * args.fps / 10:.1f}% of a core at {args.fps} fps")
+        prev = cpu_ms
+    return 0
+
+
+def apply_probe(sessions, args, ladder):
+    """Probe every receiver and seed the initial settings from the results."""
+    from lilkastream.probe import probe_sessions
+
+    results = probe_sessions(sessions, args.size[0], args.size[1])
+    choices = [r.choose(args.max_fps, args.quality, args.fps) for r in results]
+    # One encode feeds every receiver unless tiles or layers are per receiver
+    quality = min(q for q, _ in choices)
+    fps = min(f for _, f in choices)
+    if args.probe_only:
+        print(f"QUALITY={quality}")
+        print(f"FPS={fps}")
+        return
+
+    args.quality = quality
+    if ladder is not None:
+        # Lower-resolution layers can keep the capture rate where a single
+        # full-size stream would have to drop frames
+        layers = [r.choose_layer(ladder, args.fps, args.size) for r in results]
+        for session, layer, (session_quality, _) in zip(sessions, layers, choices):
+            session.controller.layer = layer if layer is not None else ladder.layer_for(session_quality)
+        if all(layer is not None for layer in layers):
+            fps = args.fps
+    if args.file:
+        args.fps = fps
+    elif args.source == "raw":
+        args.send_fps = min(fps, args.fps)
+        if ladder is not None:
+            ladder.fps = args.send_fps
+    for session, (session_quality, _) in zip(sessions, choices):
+        if session.encoder is not None:
+            session.encoder.quality = session_quality
+    if args.file:
+        log(f"Starting at quality {quality}, {fps} fps")
+    elif ladder is not None:
+        starts = ", ".join(f"{s.name}{ladder.describe(s.controller.layer)}" for s in sessions)
+        log(f"Starting at {starts}, {args.send_fps} of {args.fps} fps")
+    elif args.source == "raw":
+        log(f"Starting at quality {quality}, {args.send_fps} of {args.fps} fps")
+    elif args.source == "camera":
+        log(f"Scaled camera frames start at quality {quality}; probe suggests {fps} fps")
+    else:
+        log(f"Encoder quality is set upstream; probe suggests quality {quality}, {fps} fps")
+
+
+def parse_target(text, default_port, default_pace):
+    """IP[:PORT][/PACE] -> (host, port, pace)."""
+    text, _, pace = text.partition("/")
+    host, _, port = text.partition(":")
+    return host, int(port) if port else default_port, pace or default_pace
+
+
+def load_jpegs(path):
+    if os.path.isfile(path):
+        with open(path, "rb") as f:
+            return list(read_frames(f))
+    frames = []
+    for root, _, files in sorted(os.walk(path)):
+        for name in sorted(files):
+            if name.lower().endswith((".jpg", ".jpeg")):
+                with open(os.path.join(root, name), "rb") as f:
+                    frames.append(f.read())
+    return frames
+
+
+def bench_camera_path(args):
+    from lilkastream.camera import bench_camera
+
+    frames = load_jpegs(args.bench_camera)
+    if not frames:
+        log(f"ERROR: no JPEG frames in {args.bench_camera}")
+        return 1
+    results, (passed, scaled, failed) = bench_camera(frames, args.size, args.quality)
+    print(f"{len(frames)} frames for {args.size[0]}x{args.size[1]} at quality {args.quality}:"
+          f" {passed} pass through, {scaled} DCT-scaled, {failed} unusable")
+    base = results[0][1]
+    for name, cpu_ms, size in results:
+        print(f"  {name:22} {cpu_ms:7.2f} ms CPU/frame ({cpu_ms / base * 100:.0f}%),"
+              f" {size / 1024:.1f} KB/frame, {cpu_ms * args.fps / 10:.1f}% of a core at {args.fps} fps")
+    return 0
+
+
+def bench_denoise_path(args):
+    from lilkastream.denoise import bench_denoise
+
+    frames = load_images(args.bench_denoise, args.size)
+    if not frames:
+        log(f"ERROR: no images in {args.bench_denoise}")
+        return 1
+    clean = load_images(args.bench_reference, args.size) if args.bench_reference else None
+    if clean is not None and len(clean) != len(frames):
+        log("ERROR: reference and noisy corpora differ in frame count")
+        return 1
+    print(f"{len(frames)} frames at {args.size[0]}x{args.size[1]}, quality {args.quality}")
+    base_bytes = base_us = None
+    for strength, cpu_ms, same, matched in bench_denoise(frames, args.quality, clean=clean):
+        nbytes, decode_us, score = same
+        base_bytes, base_us = base_bytes or nbytes, base_us or decode_us
+        name = f"strength {strength}" if strength else "no denoise"
+        line = (f"  {name:11} host {cpu_ms:4.2f} ms/frame | {nbytes / 1024:5.1f} KB/frame"
+                f" ({nbytes / base_bytes * 100:3.0f}%), decode {decode_us / 1000:5.2f} ms/frame"
+                f" ({decode_us / base_us * 100:3.0f}%)")
+        if score is not None:
+            line += f", PSNR {score:.1f} dB"
+        print(line)
+        if matched is not None:
+            quality, nbytes, decode_us, score = matched
+            print(f"  {'':11} equal PSNR at quality {quality}: {nbytes / 1024:5.1f} KB/frame"
+                  f" ({nbytes / base_bytes * 100:3.0f}%), decode {decode_us / 1000:5.2f} ms/frame"
+                  f" ({decode_us / base_us * 100:3.0f}%), PSNR {score:.1f} dB")
+    return 0
+
+
+def print_histogram(values, bucket_ms, buckets):
+    counts = [0] * buckets
+    for us in values:
+        counts[min(int(us / 1000.0 / bucket_ms), buckets - 1)] += 1
+    for i, count in enumerate(counts):
+        if count:
+            label = f"{i * bucket_ms:3.0f}-{(i + 1) * bucket_ms:.0f} ms" if i + 1 < buckets else \
+                f">={i * bucket_ms:.0f} ms"
+            print(f"    {label:>10} {count:4d} {'#' * max(1, count * 40 // len(values))}")
+
+
+def bench_scene_cut_path(args):
+    from lilkastream.scenecut import bench_scene_cuts, distribution
+
+    frames = load_images(args.bench_scene_cut, args.size)
+    if len(frames) < 2:
+        log(f"ERROR: need ordered frames in {args.bench_scene_cut}")
+        return 1
+    mode = args.scene_cut or "quality"
+    runs, cuts = bench_scene_cuts(frames, args.quality, mode, args.link_kbps, args.fps, args.tiles)
+    print(f"{len(frames)} {'tiled ' if args.tiles else ''}frames at {args.size[0]}x{args.size[1]},"
+          f" quality {args.quality}, {args.fps} fps, {args.link_kbps} kbps link, cut frames by {mode}")
+    print(f"  {len(cuts)} cuts detected at frames {cuts}")
+    # The first frames of a new scene are the ones that back up the receiver
+    around = sorted({i + k for i in cuts for k in range(3) if i + k < len(frames)})
+    for name, stats in runs.items():
+        sizes = [s[0] for s in stats]
+        decode = [s[1] for s in stats]
+        latency = [s[2] for s in stats]
+        print(f"  {name}: {sum(sizes) / len(sizes) / 1024:.1f} KB/frame, first 3 frames after cuts"
+              f" {sum(sizes[i] for i in around) / max(len(around), 1) / 1024:.1f} KB/frame,"
+              f" {max((latency[i] for i in around), default=0) / 1000:.0f} ms worst latency")
+        print(f"    decode p50/p90/p99/max {'/'.join(f'{v / 1000:.1f}' for v in distribution(decode))} ms,"
+              f" latency {'/'.join(f'{v / 1000:.1f}' for v in distribution(latency))} ms")
+        print_histogram(latency, 10.0, 10)
+    return 0
+
+
+def bench_fanout_path(args):
+    from lilkastream.mux import bench_fanout
+
+    receivers = args.bench_fanout
+    print(f"{receivers} local receivers, {args.bench_frames} frames per run;"
+          " sender CPU per MB delivered to all receivers")
+    for kb in (16, 64):
+        copy_s, _, _ = bench_fanout(receivers, kb * 1024, args.bench_frames, zerocopy=False)
+        zc_s, sends, copied = bench_fanout(receivers, kb * 1024, args.bench_frames, zerocopy=True)
+        print(f"  {kb:2d} KB frames: copy {copy_s * 1000:.2f} ms/MB, zero-copy {zc_s * 1000:.2f} ms/MB"
+              f" ({zc_s / copy_s * 100:.0f}%), {sends} zero-copy sends, {copied} copied by the kernel")
+    if copied:
+        print("  (loopback always copies: the gain here is from gathered sends without per-chunk"
+              " copies; on a NIC the payload is not copied at all)")
+    return 0
+
+
+def main():
+    from lilkastream.frames import parse_size
+    from lilkastream.simulcast import parse_layers
+
+    parser = argparse.ArgumentParser(description="Multiplexed MJPEG sender for Lilka")
+    parser.add_argument("hosts", nargs="*", metavar="IP[:PORT][/PACE]",
+                        help="Lilka receivers, optionally with their own --pace setting")
+    parser.add_argument("--port", type=int, default=8090, help="Default TCP port (default: 8090)")
+    parser.add_argument("--source", choices=("mjpeg", "camera", "raw"), default="mjpeg",
+                        help="stdin format (default: mjpeg)")
+    parser.add_argument("--size", type=parse_size, default=(280, 240),
+                        help="Raw frame size, or display size for camera frames, WxH (default: 280x240)")
+    parser.add_argument("--fps", type=int, default=15, help="Source frame rate (default: 15)")
+    parser.add_argument("--quality", type=int, default=50, help="JPEG quality for raw sources and scaled camera frames (default: 50)")
+    parser.add_argument("--tiles", action="store_true",
+                        help="Raw source: choose a codec per tile (JPEG, palette/RLE, RGB565)")
+    parser.add_argument("--layers", type=parse_layers,
+                        help="Raw source: simulcast JPEG qualities with optional lower resolutions,"
+                             " e.g. 30@140x120,50,80")
+    parser.add_argument("--scene-cut", choices=("quality", "resolution"),
+                        help="Raw source: encode scene cuts at lower quality or half resolution"
+                             " (--tiles: quality only; not with --layers), then recover over a few frames")
+    parser.add_argument("--denoise", type=int, choices=(1, 2, 3),
+                        help="Raw or camera source: temporal denoise strength before encoding"
+                             " (camera frames are then always re-encoded)")
+    parser.add_argument("--file", help="Video file to transcode once (cached) and loop")
+    parser.add_argument("--once", action="store_true", help="With --file: play once instead of looping")
+    parser.add_argument("--cache-dir", default=None,
+                        help="Transcode cache directory (default: ~/.cache/lilka-stream)")
+    parser.add_argument("--link-kbps", type=int, default=4000,
+                        help="Expected link rate used to weigh bytes against decode time (default: 4000)")
+    parser.add_argument("--classify-corpus", metavar="DIR",
+                        help="Report tile codec mix per image directory and exit")
+    parser.add_argument("--bench-layers", metavar="DIR",
+                        help="Measure host CPU per simulcast layer on images in DIR and exit")
+    parser.add_argument("--bench-camera", metavar="DIR|FILE",
+                        help="Compare camera passthrough/DCT scaling with decode/scale/encode on"
+                             " JPEGs in DIR or an MJPEG file and exit")
+    parser.add_argument("--bench-denoise", metavar="DIR",
+                        help="Measure bytes and predicted decode time per denoise strength on the"
+                             " ordered frames in DIR and exit")
+    parser.add_argument("--bench-reference", metavar="DIR",
+                        help="With --bench-denoise: noise-free frames to score the output against")
+    parser.add_argument("--bench-scene-cut", metavar="DIR",
+                        help="Compare per-frame size and predicted frame time with and without"
+                             " the scene-cut budget on the ordered frames in DIR and exit")
+    parser.add_argument("--bench-fanout", type=int, metavar="N",
+                        help="Measure sender CPU per delivered MB with and without --zerocopy"
+                             " against N local receivers and exit")
+    parser.add_argument("--bench-frames", type=int, default=300,
+                        help="Frames per --bench-fanout run (default: 300)")
+    parser.add_argument("--zerocopy", action="store_true",
+                        help="Send frames from one shared buffer with MSG_ZEROCOPY (Linux)")
+    parser.add_argument("--pace", default="off",
+                        help="Video pacing: off, frame (spread each frame over the frame interval)"
+                             " or a rate in kbps (default: off)")
+    parser.add_argument("--probe", action="store_true",
+                        help="Measure goodput and decode speed at connect to pick the initial quality")
+    parser.add_argument("--probe-only", action="store_true",
+                        help="Probe, print QUALITY= and FPS= for the shell and exit")
+    parser.add_argument("--max-fps", type=int, default=30,
+                        help="Highest frame rate the probe may choose (default: 30)")
+    parser.add_argument("--metrics-port", type=int,
+                        help="Serve Prometheus metrics for all receivers on this local port")
+    parser.add_argument("--metrics-bind", default="127.0.0.1",
+                        help="Address for the metrics server (default: 127.0.0.1)")
+    parser.add_argument("--relay", action="append", default=[], metavar="IP[:PORT]",
+                        help="Downstream receiver the first receiver relays to (repeat for a chain"
+                             " or tree, in order)")
+    parser.add_argument("--relay-fanout", type=int, choices=(1, 2), default=1,
+                        help="Downstreams per relaying receiver: 1 = chain, 2 = binary tree (default: 1)")
+    parser.add_argument("--ping-interval", type=float, default=0.2,
+                        help="Control ping interval in seconds (default: 0.2)")
+    parser.add_argument("--stats-interval", type=float, default=2.0,
+                        help="Stats report interval in seconds (default: 2)")
+    args = parser.parse_args()
+    args.send_fps = args.fps
+
+    # Checked before the benchmarks too, so --bench-scene-cut never measures
+    # a combination that streaming would not run
+    if (args.scene_cut or args.bench_scene_cut) and args.layers:
+        parser.error("--scene-cut cannot be combined with --layers")
+    if args.scene_cut == "resolution" and args.tiles:
+        parser.error("tiled frames can only lower quality at a scene cut")
+
+    if args.classify_corpus:
+        return classify_corpus(args)
+    if args.bench_layers:
+        return bench_ladder(args)
+    if args.bench_camera:
+        return bench_camera_path(args)
+    if args.bench_denoise:
+        return bench_denoise_path(args)
+    if args.bench_scene_cut:
+        return bench_scene_cut_path(args)
+    if args.bench_fanout:
+        return bench_fanout_path(args)
+    if not args.hosts:
+        parser.error("at least one receiver is required")
+    if (args.tiles or args.layers) and args.source != "raw":
+        parser.error("--tiles and --layers require --source raw")
+    if args.scene_cut and args.source != "raw":
+        parser.error("--scene-cut requires --source raw")
+    if args.denoise and args.source == "mjpeg":
+        parser.error("--denoise requires --source raw or camera")
+    if args.tiles and args.layers:
+        parser.error("--tiles and --layers cannot be combined")
+    if args.file and (args.tiles or args.layers or args.denoise):
+        parser.error("--file streams pre-encoded frames and cannot use --tiles, --layers or --denoise")
+    if args.relay and len(args.hosts) != 1:
+        parser.error("--relay needs exactly one directly connected receiver")
+    if len(args.relay) > proto.RELAY_MAX_NODES:
+        parser.error(f"at most {proto.RELAY_MAX_NODES} relayed receivers")
+    if args.cache_dir is None:
+        from lilkastream.cache import DEFAULT_CACHE_DIR
+        args.cache_dir = DEFAULT_CACHE_DIR
+
+    ladder = None
+    if args.layers:
+        from lilkastream.simulcast import Ladder
+        ladder = Ladder(args.layers, args.fps)
+
+    sessions = []
+    for target in args.hosts:
+        host, port, pace = parse_target(target, args.port, args.pace)
+        session = Session(f"[{host}:{port}] " if len(args.hosts) > 1 else "", f"{host}:{port}")
+        try:
+            pacer = parse_pace(pace)
+        except ValueError:
+            parser.error(f"invalid pace for {target}: {pace}")
+        try:
+            session.conn = MuxConnection(host, port, on_message=session.on_message, pacer=pacer,
+                                         zerocopy=args.zerocopy)
+        except OSError as e:
+            log(f"ERROR: cannot connect to {host}:{port}: {e}")
+            return 1
+        if args.tiles:
+            from lilkastream.tiles import TileEncoder
+            session.encoder = TileEncoder(args.size[0], args.size[1], args.quality, args.link_kbps)
+            session.on_refresh = session.encoder.invalidate
+        if ladder is not None:
+            from lilkastream.simulcast import LayerController
+            session.controller = LayerController(ladder, session.name)
+            session.on_ack = session.controller.on_ack
+        log(f"Connected to {host}:{port} (multiplexed{', paced ' + pace if pace != 'off' else ''})")
+        sessions.append(session)
+
+    if args.relay:
+        import socket
+        nodes = []
+        for target in args.relay:
+            host, port, _ = parse_target(target, args.port, "off")
+            nodes.append((socket.gethostbyname(host), port))
+        sessions[0].conn.send_message(proto.CH_CONTROL, proto.relay_message(args.relay_fanout, nodes))
+        log(f"Relaying through {len(nodes)} receiver(s), fan-out {args.relay_fanout}")
+
+    if args.metrics_port:
+        from lilkastream.metrics import start_exporter
+        start_exporter(sessions, args.metrics_port, args.metrics_bind)
+        log(f"Metrics on http://{args.metrics_bind}:{args.metrics_port}/metrics")
+
+    for session in sessions:
+        threading.Thread(target=control_loop,
+                         args=(session, args.ping_interval, args.stats_interval),
+                         daemon=True).start()
+
+    if args.probe or args.probe_only:
+        apply_probe(sessions, args, ladder)
+        if args.probe_only:
+            for session in sessions:
+                session.conn.close()
+            return 0
+
+    # Frames every receiver gets are shared rather than copied per connection
+    pool = FramePool() if args.zerocopy else None
+    if args.file:
+        ok = stream_file(sessions, args, pool)
+    elif args.source == "raw":
+        ok = stream_raw(sessions, args, ladder, pool)
+    elif args.source == "camera":
+        ok = stream_camera(sessions, args, pool)
+    else:
+        ok = stream_mjpeg(sessions, pool)
+    if not ok:
+        log("All receivers disconnected")
+        return 1
+
+    for session in sessions:
+        session.conn.wait_idle()
+        session.conn.close()
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
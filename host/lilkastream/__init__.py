@@ -0,0 +1 @@
+"""Host-side sender for the Lilka MJPEG stream receiver."""
@@ -0,0 +1,136 @@
+"""Pre-transcoded clip cache for looping playback.
+
+A video file is transcoded once (via GStreamer) into receiver-ready MJPEG at
+the requested size, frame rate and quality. The result is cached under a key
+derived from the file's content hash and those settings, then streamed
+straight from an mmap with timestamp pacing - no per-frame decode or encode.
+
+Cache layout (one directory per key):
+    frames.mjpeg  - concatenated JPEG frames
+    index.bin     - per frame: offset u64, size u32, pts us u64 (little endian)
+    meta.json     - source, settings, frame count and duration
+"""
+
+import hashlib
+import json
+import mmap
+import os
+import shutil
+import struct
+import subprocess
+import tempfile
+import time
+
+from .log import log
+from .mjpeg import read_frames
+from .mux import fan_out
+
+INDEX_ENTRY = struct.Struct("<QIQ")
+DEFAULT_CACHE_DIR = os.path.join(os.path.expanduser("~"), ".cache", "lilka-stream")
+
+
+def content_key(path, width, height, fps, quality):
+    digest = hashlib.sha256()
+    with open(path, "rb") as f:
+        for block in iter(lambda: f.read(1 << 20), b""):
+            digest.update(block)
+    digest.update(f"|{width}x{height}|{fps}|q{quality}|baseline420".encode())
+    return digest.hexdigest()[:32]
+
+
+def transcode(path, out_dir, width, height, fps, quality):
+    """Decode, scale and encode the whole file once with GStreamer."""
+    pipeline = [
+        "gst-launch-1.0", "-q",
+        "filesrc", f"location={path}", "!", "decodebin",
+        "!", "videoconvert", "!", "videoscale", "method=lanczos", "add-borders=true",
+        "!", f"video/x-raw,width={width},height={height},pixel-aspect-ratio=1/1",
+        "!", "videorate", "!", f"video/x-raw,framerate={fps}/1",
+        "!", "videoconvert", "!", "video/x-raw,format=I420",
+        "!", "jpegenc", f"quality={quality}",
+        "!", "fdsink", "fd=1",
+    ]
+    proc = subprocess.Popen(pipeline, stdout=subprocess.PIPE)
+    frame_us = 1_000_000 // fps
+    count = offset = 0
+    with open(os.path.join(out_dir, "frames.mjpeg"), "wb") as data, \
+            open(os.path.join(out_dir, "index.bin"), "wb") as index:
+        for jpeg in read_frames(proc.stdout):
+            data.write(jpeg)
+            index.write(INDEX_ENTRY.pack(offset, len(jpeg), count * frame_us))
+            offset += len(jpeg)
+            count += 1
+    if proc.wait() != 0 or count == 0:
+        raise RuntimeError(f"transcoding {path} failed (gst-launch exit {proc.returncode})")
+    return count, count * frame_us
+
+
+class CachedClip:
+    def __init__(self, directory):
+        with open(os.path.join(directory, "meta.json")) as f:
+            self.meta = json.load(f)
+        with open(os.path.join(directory, "index.bin"), "rb") as f:
+            raw = f.read()
+        self.index = [INDEX_ENTRY.unpack_from(raw, i) for i in range(0, len(raw), INDEX_ENTRY.size)]
+        self._file = open(os.path.join(directory, "frames.mjpeg"), "rb")
+        self._map = mmap.mmap(self._file.fileno(), 0, access=mmap.ACCESS_READ)
+        self.view = memoryview(self._map)
+        self.duration_us = self.meta["duration_us"]
+
+    def __len__(self):
+        return len(self.index)
+
+    def frame(self, i):
+        offset, size, pts_us = self.index[i]
+        return self.view[offset:offset + size], pts_us
+
+
+def open_clip(path, width, height, fps, quality, cache_dir=DEFAULT_CACHE_DIR):
+    """Return the cached clip for these settings, transcoding on first use."""
+    key = content_key(path, width, height, fps, quality)
+    directory = os.path.join(cache_dir, key)
+    if os.path.exists(os.path.join(directory, "meta.json")):
+        log(f"Using cached transcode {directory}")
+        return CachedClip(directory)
+
+    os.makedirs(cache_dir, exist_ok=True)
+    tmp = tempfile.mkdtemp(prefix=".transcode-", dir=cache_dir)
+    try:
+        log(f"Transcoding {path} to {width}x{height} @ {fps} fps, quality {quality}...")
+        start = time.monotonic()
+        count, duration_us = transcode(path, tmp, width, height, fps, quality)
+        with open(os.path.join(tmp, "meta.json"), "w") as f:
+            json.dump({"source": os.path.abspath(path), "width": width, "height": height,
+                       "fps": fps, "quality": quality, "frames": count,
+                       "duration_us": duration_us}, f, indent=2)
+        os.replace(tmp, directory)
+        log(f"Cached {count} frames in {time.monotonic() - start:.1f} s -> {directory}")
+    except BaseException:
+        shutil.rmtree(tmp, ignore_errors=True)
+        raise
+    return CachedClip(directory)
+
+
+def play(clip, targets, loop=True, pool=None):
+    """Send cached frames paced by their timestamps to every live target.
+
+    `targets` is called each frame and returns the connections to send to;
+    playback stops when it returns none. Frames are scheduled against an
+    absolute clock, so pacing does not drift over long loops. With a
+    FramePool every target sends from one shared copy of the frame.
+    """
+    start = time.monotonic()
+    base_us = 0
+    while True:
+        for i in range(len(clip)):
+            jpeg, pts_us = clip.frame(i)
+            delay = start + (base_us + pts_us) / 1e6 - time.monotonic()
+            if delay > 0:
+                time.sleep(delay)
+            conns = targets()
+            if not conns:
+                return False
+            fan_out(conns, jpeg, pool)
+        if not loop:
+            return True
+        base_us += clip.duration_us
@@ -0,0 +1,214 @@
+"""MJPEG camera frames made receiver-ready with as little work as possible.
+
+USB webcams and IP cameras already deliver JPEG. A frame that TJpgDec can
+decode as it is (baseline, 8-bit tables, 4:4:4/4:2:2/4:2:0 or greyscale, no
+larger than the display) is passed through untouched; the only fix-up is
+the standard Huffman tables, which many webcams leave out of their MJPEG
+frames. Larger frames are scaled down inside the decoder: libjpeg's scaled
+IDCT keeps only the low-frequency coefficients of each block and produces
+1/2, 1/4 or 1/8 of the size without ever reconstructing the full-resolution
+pixels. The remaining (less than 2x) step is a cheap bilinear resize in
+YCbCr, followed by the encode at the target quality. With a temporal
+denoiser every frame takes that path, since the filter needs pixels.
+"""
+
+import io
+import time
+
+from PIL import Image
+
+from .mjpeg import SOI
+
+# Receiver frame slot size (MAX_JPEG_SIZE in src/main.cpp)
+MAX_FRAME_BYTES = 100 * 1024
+
+SOF0, DHT, SOS, DQT = 0xC0, 0xC4, 0xDA, 0xDB
+# Start-of-frame markers; everything but SOF0 is beyond TJpgDec
+SOF_MARKERS = set(range(0xC0, 0xD0)) - {DHT, 0xC8, 0xCC}
+# Luma sampling factors TJpgDec handles; chroma must be 1x1
+LUMA_SAMPLING = (0x11, 0x21, 0x22)
+
+_standard_dht = None
+
+
+class JpegInfo:
+    def __init__(self):
+        self.sof = None
+        self.width = self.height = 0
+        self.precision = 8
+        self.sampling = ()
+        self.table_precision = 0  # Highest DQT precision (0 = 8-bit)
+        self.has_dht = False
+        self.sos_offset = 0
+
+
+def parse_headers(jpeg):
+    """Marker segments up to the scan, or None when the frame is malformed."""
+    if not jpeg.startswith(SOI):
+        return None
+    info = JpegInfo()
+    pos = 2
+    while pos + 4 <= len(jpeg):
+        if jpeg[pos] != 0xFF:
+            return None
+        marker = jpeg[pos + 1]
+        if marker == 0xFF:
+            pos += 1
+            continue
+        length = (jpeg[pos + 2] << 8) | jpeg[pos + 3]
+        if length < 2 or pos + 2 + length > len(jpeg):
+            return None  # Frame ends inside this segment
+        segment = jpeg[pos + 4:pos + 2 + length]
+        if marker == SOS:
+            info.sos_offset = pos
+            return info if info.sof is not None else None
+        if marker in SOF_MARKERS:
+            if len(segment) < 6 or len(segment) < 6 + 3 * segment[5]:
+                return None
+            info.sof = marker
+            info.precision = segment[0]
+            info.height = (segment[1] << 8) | segment[2]
+            info.width = (segment[3] << 8) | segment[4]
+            info.sampling = tuple(segment[6 + 3 * i + 1] for i in range(segment[5]))
+        elif marker == DQT:
+            i = 0
+            while i < len(segment):
+                table_precision = segment[i] >> 4
+                info.table_precision = max(info.table_precision, table_precision)
+                i += 1 + (128 if table_precision else 64)
+        elif marker == DHT:
+            info.has_dht = True
+        pos += 2 + length
+    return None
+
+
+def decodable(info):
+    """TJpgDec accepts the coding, tables and sampling of this frame."""
+    if info.sof != SOF0 or info.precision != 8 or info.table_precision != 0:
+        return False
+    if len(info.sampling) == 1:
+        return True
+    return (len(info.sampling) == 3 and info.sampling[0] in LUMA_SAMPLING
+            and info.sampling[1] == info.sampling[2] == 0x11)
+
+
+def standard_dht():
+    """DHT segments with the Annex K tables, as libjpeg writes by default."""
+    global _standard_dht
+    if _standard_dht is None:
+        out = io.BytesIO()
+        Image.new("RGB", (16, 16)).save(out, "JPEG", optimize=False)
+        header = parse_headers(out.getvalue())
+        data = out.getvalue()[:header.sos_offset]
+        segments, pos = [], 2
+        while pos < len(data):
+            length = (data[pos + 2] << 8) | data[pos + 3]
+            if data[pos + 1] == DHT:
+                segments.append(data[pos:pos + 2 + length])
+            pos += 2 + length
+        _standard_dht = b"".join(segments)
+    return _standard_dht
+
+
+def fit_size(source, display):
+    """Largest size with the source aspect ratio that fits the display."""
+    scale = min(display[0] / source[0], display[1] / source[1], 1.0)
+    return max(1, round(source[0] * scale)), max(1, round(source[1] * scale))
+
+
+def decode_scaled(jpeg, size):
+    """Decode at the display size, scaling in the DCT domain where possible."""
+    img = Image.open(io.BytesIO(jpeg))
+    target = fit_size(img.size, size)
+    img.draft("YCbCr" if img.mode == "RGB" else img.mode, target)
+    if img.size != target:
+        img = img.resize(target, Image.BILINEAR)
+    return img
+
+
+def scale_jpeg(jpeg, size, quality, denoiser=None):
+    """Downscale in the DCT domain, finish with a small resize, encode."""
+    img = decode_scaled(jpeg, size)
+    if denoiser is not None and img.mode != "L":
+        import numpy as np
+        filtered = denoiser.filter(np.asarray(img))
+        img = Image.frombytes(img.mode, img.size, filtered.tobytes())
+    out = io.BytesIO()
+    img.save(out, "JPEG", quality=quality, subsampling="4:2:0")
+    return out.getvalue()
+
+
+def full_transcode(jpeg, size, quality):
+    """Reference path: full decode to RGB, Lanczos scale, encode."""
+    from .frames import encode_jpeg
+    import numpy as np
+
+    img = Image.open(io.BytesIO(jpeg)).convert("RGB")
+    img = img.resize(fit_size(img.size, size), Image.LANCZOS)
+    return encode_jpeg(np.asarray(img), quality)
+
+
+class CameraTranscoder:
+    """Pass through or DCT-scale camera frames for a display of `size`."""
+
+    def __init__(self, size, quality, max_bytes=MAX_FRAME_BYTES, denoiser=None):
+        self.size = size
+        self.quality = quality
+        self.max_bytes = max_bytes
+        self.denoiser = denoiser
+        self.passed = self.scaled = self.failed = 0
+        self.cpu_s = 0.0
+
+    def convert(self, jpeg):
+        """Receiver-ready JPEG, or None for a frame that cannot be used."""
+        start = time.process_time()
+        try:
+            return self._convert(jpeg)
+        finally:
+            self.cpu_s += time.process_time() - start
+
+    def _convert(self, jpeg):
+        info = parse_headers(jpeg)
+        if info is None:
+            self.failed += 1
+            return None
+        if (self.denoiser is None and decodable(info) and info.width <= self.size[0] and info.height <= self.size[1]
+                and len(jpeg) <= self.max_bytes):
+            self.passed += 1
+            if info.has_dht:
+                return jpeg
+            pos = info.sos_offset
+            return jpeg[:pos] + standard_dht() + jpeg[pos:]
+        try:
+            out = scale_jpeg(jpeg, self.size, self.quality, self.denoiser)
+        except OSError:
+            self.failed += 1
+            return None
+        self.scaled += 1
+        return out
+
+    def take_report(self):
+        frames = self.passed + self.scaled + self.failed
+        report = (self.passed, self.scaled, self.failed,
+                  self.cpu_s * 1000.0 / max(frames, 1))
+        self.passed = self.scaled = self.failed = 0
+        self.cpu_s = 0.0
+        return report
+
+
+def bench_camera(frames, size, quality):
+    """Host CPU and output size per frame: camera path vs full transcode."""
+    transcoder = CameraTranscoder(size, quality)
+    results = []
+    for name, convert in (("decode/scale/encode", lambda j: full_transcode(j, size, quality)),
+                          ("passthrough/DCT scale", transcoder.convert)):
+        convert(frames[0])  # Warm up
+        transcoder.take_report()
+        total = 0
+        start = time.process_time()
+        for jpeg in frames:
+            out = convert(jpeg)
+            total += len(out) if out else 0
+        cpu_ms = (time.process_time() - start) * 1000.0 / len(frames)
+        results.append((name, cpu_ms, total / len(frames)))
+    return results, transcoder.take_report()[:3]
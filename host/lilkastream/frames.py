@@ -0,0 +1,40 @@
+"""Raw RGB frame source and JPEG encoding (requires numpy and Pillow)."""
+
+import io
+
+import numpy as np
+from PIL import Image
+
+
+def read_raw_frames(stream, width, height):
+    """Yield HxWx3 uint8 RGB frames from a raw video/x-raw,format=RGB stream."""
+    frame_size = width * height * 3
+    while True:
+        data = stream.read(frame_size)
+        if len(data) < frame_size:
+            return
+        yield np.frombuffer(data, dtype=np.uint8).reshape(height, width, 3)
+
+
+def encode_jpeg(rgb, quality):
+    """Baseline JPEG that TJpgDec can decode."""
+    out = io.BytesIO()
+    Image.fromarray(rgb).save(out, "JPEG", quality=quality, subsampling="4:2:0")
+    return out.getvalue()
+
+
+def resize(rgb, size):
+    """Downscale an RGB frame to (width, height)."""
+    return np.asarray(Image.fromarray(rgb).resize(size, Image.BILINEAR, reducing_gap=2.0))
+
+
+def rgb565(rgb):
+    r = rgb[..., 0].astype(np.uint16)
+    g = rgb[..., 1].astype(np.uint16)
+    b = rgb[..., 2].astype(np.uint16)
+    return ((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3)
+
+
+def parse_size(text):
+    width, height = text.lower().split("x")
+    return int(width), int(height)
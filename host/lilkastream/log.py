@@ -0,0 +1,12 @@
+"""Thread-safe status output on stderr (stdout may carry video)."""
+
+import sys
+import threading
+
+_lock = threading.Lock()
+
+
+def log(message):
+    with _lock:
+        sys.stderr.write(message + "\n")
+        sys.stderr.flush()
@@ -0,0 +1,122 @@
+"""Prometheus text-format exporter for per-receiver stream metrics.
+
+Receivers push a TELEM_STATS message once per second; the exporter only
+formats the latest values when scraped, so it costs nothing between scrapes.
+"""
+
+import threading
+import time
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+from .session import RTT_WINDOW
+from .stats import percentile
+
+DEVICE_GAUGES = (
+    ("fps", "lilka_fps", "Frames decoded per second"),
+    ("kbps", "lilka_bandwidth_kbps", "Stream bandwidth received by the device"),
+    ("rssi", "lilka_wifi_rssi_dbm", "WiFi signal strength"),
+    ("queue_depth", "lilka_queue_depth", "Frames waiting for the decoder"),
+    ("uptime", "lilka_uptime_seconds", "Device uptime"),
+    # A 16-bit count on the device, so it wraps and cannot be a counter
+    ("reconnects", "lilka_connections", "Stream connections accepted since boot, modulo 65536"),
+)
+
+DEVICE_COUNTERS = (
+    ("dropped", "lilka_frames_dropped_total", "Frames dropped by the device queue"),
+    ("decoded", "lilka_frames_decoded_total", "Frames decoded by the device"),
+)
+
+# Telemetry older than this marks the receiver as down
+STALE_AFTER = 5.0
+
+
+def _escape(value):
+    return value.replace("\\", "\\\\").replace('"', '\\"')
+
+
+def render(sessions):
+    now = time.monotonic()
+    lines = []
+
+    def sample(name, labels, value):
+        label_text = ",".join(f'{k}="{_escape(str(v))}"' for k, v in labels.items())
+        lines.append(f"{name}{{{label_text}}} {value}")
+
+    def metric(name, kind, help_text, samples):
+        lines.append(f"# HELP {name} {help_text}")
+        lines.append(f"# TYPE {name} {kind}")
+        for labels, value in samples:
+            sample(name, labels, value)
+
+    live = [(s, {"receiver": s.target}) for s in sessions]
+    metric("lilka_up", "gauge", "Receiver connected and reporting telemetry",
+           [(labels, int(not s.conn.closed and s.device is not None and now - s.device_time < STALE_AFTER))
+            for s, labels in live])
+
+    reporting = [(s, labels, s.device) for s, labels in live if s.device is not None]
+    for key, name, help_text in DEVICE_GAUGES:
+        metric(name, "gauge", help_text, [(labels, dev[key]) for _, labels, dev in reporting])
+    for key, name, help_text in DEVICE_COUNTERS:
+        metric(name, "counter", help_text, [(labels, dev[key]) for _, labels, dev in reporting])
+
+    samples = []
+    for _, labels, dev in reporting:
+        for quantile, key in (("0.5", "decode_p50_us"), ("0.9", "decode_p90_us"), ("0.99", "decode_p99_us")):
+            samples.append(({**labels, "quantile": quantile}, dev[key]))
+    # The device sends percentiles only, without a sum or count
+    metric("lilka_decode_microseconds", "gauge", "Device frame decode time percentiles over the last second",
+           samples)
+
+    metric("lilka_sender_frames_total", "counter", "Frames sent to the receiver",
+           [(labels, s.conn.frames_sent) for s, labels in live])
+    metric("lilka_sender_bytes_total", "counter", "Bytes sent to the receiver",
+           [(labels, s.conn.bytes_sent) for s, labels in live])
+    metric("lilka_sender_frames_stale_total", "counter", "Frames dropped by the sender before transmission",
+           [(labels, s.conn.frames_stale) for s, labels in live])
+
+    tcp = [(labels, s.conn.tcp_info()) for s, labels in live]
+    tcp = [(labels, info) for labels, info in tcp if info is not None]
+    metric("lilka_tcp_srtt_milliseconds", "gauge", "Kernel smoothed TCP round trip time",
+           [(labels, f"{info[0]:.3f}") for labels, info in tcp])
+    metric("lilka_tcp_retransmits_total", "counter", "TCP segments retransmitted to the receiver",
+           [(labels, info[2]) for labels, info in tcp])
+
+    # Receivers without a pong yet have no series rather than a 0 ms one
+    rtt = [(labels, s.rtt_snapshot()) for s, labels in live]
+    rtt = [(labels, snapshot) for labels, snapshot in rtt if snapshot[2]]
+    samples = []
+    for labels, (recent, _, _) in rtt:
+        for quantile, q in (("0.5", 50), ("0.99", 99)):
+            samples.append(({**labels, "quantile": quantile}, f"{percentile(recent, q):.2f}"))
+    metric("lilka_control_rtt_milliseconds", "summary",
+           f"Control message round trip time (quantiles over the last {RTT_WINDOW} pongs)", samples)
+    for labels, (_, total, count) in rtt:
+        sample("lilka_control_rtt_milliseconds_sum", labels, f"{total:.2f}")
+        sample("lilka_control_rtt_milliseconds_count", labels, count)
+
+    return "\n".join(lines) + "\n"
+
+
+class _Handler(BaseHTTPRequestHandler):
+    sessions = []
+
+    def do_GET(self):
+        if self.path.split("?")[0] not in ("/metrics", "/"):
+            self.send_error(404)
+            return
+        body = render(self.sessions).encode()
+        self.send_response(200)
+        self.send_header("Content-Type", "text/plain; version=0.0.4; charset=utf-8")
+        self.send_header("Content-Length", str(len(body)))
+        self.end_headers()
+        self.wfile.write(body)
+
+    def log_message(self, fmt, *args):
+        pass
+
+
+def start_exporter(sessions, port, host="127.0.0.1"):
+    handler = type("MetricsHandler", (_Handler,), {"sessions": sessions})
+    server = ThreadingHTTPServer((host, port), handler)
+    threading.Thread(target=server.serve_forever, name="metrics", daemon=True).start()
+    return server
@@ -0,0 +1,31 @@
+"""Splitting a raw MJPEG byte stream into JPEG frames."""
+
+SOI = b"\xff\xd8"
+EOI = b"\xff\xd9"
+
+
+def read_frames(stream, read_size=65536):
+    """Yield complete JPEG frames (SOI..EOI) from a binary stream."""
+    buf = bytearray()
+    scan = 0
+    while True:
+        data = stream.read1(read_size) if hasattr(stream, "read1") else stream.read(read_size)
+        if not data:
+            return
+        buf += data
+        while True:
+            start = buf.find(SOI)
+            if start < 0:
+                del buf[:-1]
+                scan = 0
+                break
+            if start > 0:
+                del buf[:start]
+                scan = 0
+            end = buf.find(EOI, max(scan, 2))
+            if end < 0:
+                scan = max(len(buf) - 1, 2)
+                break
+            yield bytes(buf[:end + 2])
+            del buf[:end + 2]
+            scan = 0
@@ -0,0 +1,553 @@
+"""Prioritised multiplexing of control, cursor and video on one TCP connection."""
+
+import errno
+import socket
+import struct
+import threading
+import time
+from collections import deque
+
+from . import protocol as proto
+
+# Linux values; not exported by every Python build
+TCP_NOTSENT_LOWAT = getattr(socket, "TCP_NOTSENT_LOWAT", 25)
+SO_MAX_PACING_RATE = getattr(socket, "SO_MAX_PACING_RATE", 47)
+TCP_INFO = getattr(socket, "TCP_INFO", 11)
+
+# struct tcp_info up to tcpi_total_retrans: 8 u8 fields, then u32 fields
+TCP_INFO_STRUCT = struct.Struct("<8B24I")
+TCPI_RTT = 8 + 15
+TCPI_RTTVAR = 8 + 16
+TCPI_TOTAL_RETRANS = 8 + 23
+
+SO_ZEROCOPY = getattr(socket, "SO_ZEROCOPY", 60)
+MSG_ZEROCOPY = getattr(socket, "MSG_ZEROCOPY", 0x4000000)
+MSG_ERRQUEUE = getattr(socket, "MSG_ERRQUEUE", 0x2000)
+# struct sock_extended_err: errno, origin, type, code, pad, info, data
+SOCK_EXTENDED_ERR = struct.Struct("=IBBBBII")
+SO_EE_ORIGIN_ZEROCOPY = 5
+SO_EE_CODE_ZEROCOPY_COPIED = 1
+RECVERR_LEVELS = {(socket.IPPROTO_IP, 11), (socket.IPPROTO_IPV6, 25)}  # IP(V6)_RECVERR
+# Video bytes per zero-copy send; MSG_ZEROCOPY only pays off for large sends
+ZEROCOPY_BATCH = 16 * proto.MUX_VIDEO_CHUNK
+
+
+class SharedFrame:
+    """One encoded frame sent by several connections without per-socket copies.
+
+    Reference counted: the producer holds one reference and every connection
+    that queues the frame takes another, which it drops once the kernel has
+    finished with the pages (zero-copy completion) or the frame was dropped.
+    The last release returns the buffer to its pool.
+    """
+
+    def __init__(self, buffer, size, pool=None):
+        self.buffer = buffer
+        self.view = memoryview(buffer)[:size]
+        self.pool = pool
+        self.refs = 1
+        self._lock = threading.Lock()
+
+    def __len__(self):
+        return len(self.view)
+
+    def acquire(self):
+        with self._lock:
+            self.refs += 1
+        return self
+
+    def release(self):
+        with self._lock:
+            self.refs -= 1
+            last = self.refs == 0
+        if last and self.pool is not None:
+            self.view.release()
+            self.pool.recycle(self.buffer)
+
+
+class FramePool:
+    """Recycled frame buffers, so pages pinned for zero-copy sends are reused."""
+
+    def __init__(self, keep=8):
+        self.keep = keep
+        self._free = []
+        self._lock = threading.Lock()
+        self.allocated = 0
+        self.reused = 0
+
+    def wrap(self, payload):
+        """Copy an encoded frame once into a pooled buffer shared by all senders."""
+        size = len(payload)
+        with self._lock:
+            buffer = next((b for b in self._free if len(b) >= size), None)
+            if buffer is not None:
+                self._free.remove(buffer)
+                self.reused += 1
+        if buffer is None:
+            buffer = bytearray(max(size, 64 * 1024))
+            self.allocated += 1
+        buffer[:size] = payload
+        return SharedFrame(buffer, size, self)
+
+    def recycle(self, buffer):
+        with self._lock:
+            if len(self._free) < self.keep:
+                self._free.append(buffer)
+
+
+def fan_out(conns, payload, pool=None, flags=0, meta=None):
+    """Queue the same frame on every connection, sharing one buffer."""
+    frame = pool.wrap(payload) if pool is not None else payload
+    for conn in conns:
+        conn.send_frame(frame, flags, meta)
+    if pool is not None:
+        frame.release()  # The producer's reference
+
+
+class Pacer:
+    """Spreads video over time instead of writing it at line rate.
+
+    In frame mode each frame is sent at the rate that delivers it within
+    SPREAD of the frame interval (measured from how often frames are queued),
+    so the link carries a steady trickle rather than one burst per frame that
+    overflows the AP and ESP32 receive buffers. A fixed rate caps every frame
+    at `kbps` instead, and is also handed to the kernel (SO_MAX_PACING_RATE).
+    """
+
+    SPREAD = 0.5
+    BURST = 2 * proto.MUX_VIDEO_CHUNK  # Sent back to back to save wakeups
+
+    def __init__(self, kbps=None):
+        self.fixed_rate = kbps * 1000 / 8 if kbps else None
+        self.rate = self.fixed_rate
+        self.interval = None
+        self.last_queued = None
+        self.next_time = 0.0
+
+    def frame_queued(self, now):
+        if self.last_queued is not None:
+            gap = min(max(now - self.last_queued, 0.01), 0.5)
+            self.interval = gap if self.interval is None else 0.9 * self.interval + 0.1 * gap
+        self.last_queued = now
+
+    def frame_started(self, size, now):
+        if self.fixed_rate is None:
+            self.rate = size / (self.interval * self.SPREAD) if self.interval else None
+        self.next_time = now
+
+    def wait(self, now):
+        """Seconds until the next chunk may be sent."""
+        if self.rate is None:
+            return 0.0
+        return self.next_time - self.BURST / self.rate - now
+
+    def sent(self, nbytes, now):
+        if self.rate is not None:
+            self.next_time = max(self.next_time, now - self.BURST / self.rate) + nbytes / self.rate
+
+
+def _release(payload):
+    if isinstance(payload, SharedFrame):
+        payload.release()
+
+
+def _zc_before(send_id, last):
+    """send_id <= last for the kernel's wrapping 32-bit completion ids."""
+    return ((last - send_id) & 0xFFFFFFFF) < 0x80000000
+
+
+def parse_pace(text):
+    """"off" -> None, "frame" -> Pacer(), "800" -> Pacer(800 kbps)."""
+    if text == "off":
+        return None
+    if text == "frame":
+        return Pacer()
+    return Pacer(int(text))
+
+
+class MuxConnection:
+    """Multiplexed connection to one receiver.
+
+    Small messages are always sent before the next video chunk and video frames
+    are split into MUX_VIDEO_CHUNK packets, so a cursor update waits for at most
+    one chunk instead of a whole JPEG. Only the newest not-yet-started frame is
+    kept; frames that go stale before transmission are dropped. With a Pacer,
+    video chunks are released at the paced rate while small messages still go
+    out immediately.
+
+    With zerocopy, video is written straight from the frame buffer with
+    MSG_ZEROCOPY: header and chunk are gathered with sendmsg instead of being
+    copied into one packet, several chunks go out per call when no message is
+    waiting, and a SharedFrame is only released when the kernel reports on
+    the error queue that it no longer needs the pages. Without kernel support
+    the same gather path runs with ordinary copying sends.
+    """
+
+    def __init__(self, host, port, on_message=None, chunk=proto.MUX_VIDEO_CHUNK,
+                 unsent_limit=16384, pacer=None, zerocopy=False):
+        self.host = host
+        self.port = port
+        self.on_message = on_message
+        self.chunk = chunk
+
+        self.sock = socket.create_connection((host, port), timeout=5)
+        self.sock.settimeout(None)
+        self.sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        # Keep the kernel's unsent queue short so priorities are decided here
+        # rather than behind tens of KB of video already handed to TCP
+        try:
+            self.sock.setsockopt(socket.IPPROTO_TCP, TCP_NOTSENT_LOWAT, unsent_limit)
+        except OSError:
+            self.sock.setsockopt(socket.SOL_SOCKET, socket.SO_SNDBUF, unsent_limit)
+        self.pacer = pacer
+        if pacer is not None and pacer.fixed_rate:
+            try:
+                self.sock.setsockopt(socket.SOL_SOCKET, SO_MAX_PACING_RATE, int(pacer.fixed_rate))
+            except OSError:
+                pass  # Userspace pacing still applies
+
+        self.zerocopy = zerocopy
+        self._zc_flags = 0
+        if zerocopy:
+            try:
+                self.sock.setsockopt(socket.SOL_SOCKET, SO_ZEROCOPY, 1)
+                self._zc_flags = MSG_ZEROCOPY
+            except OSError:
+                pass  # Gathered sends without MSG_ZEROCOPY
+        self._zc_next = 0            # Kernel's id for the next zero-copy send
+        self._zc_inflight = deque()  # (send id, buffers or frame) awaiting completion
+        self._finished = None        # Frame whose last chunk was just taken
+        self.zc_sends = 0
+        self.zc_copied = 0           # Sends the kernel copied anyway (e.g. loopback)
+
+        self.connected_at = time.monotonic()
+        self.closed = False
+        self._cond = threading.Condition()
+        self._messages = {ch: deque() for ch in proto.CHANNELS if ch != proto.CH_VIDEO}
+        self._pending = None
+        self._frame = None
+        self._frame_obj = None
+        self._frame_flags = 0
+        self._frame_meta = None
+        self._offset = 0
+        self._pace_wait = None
+
+        self.frames_sent = 0
+        self.frames_stale = 0
+        self.bytes_sent = 0
+        # frame seq -> (monotonic time of first chunk, meta); written by the
+        # sender thread under _cond, taken by the reader thread
+        self.frame_start_times = {}
+
+        self.sock.sendall(proto.MUX_MAGIC)
+        threading.Thread(target=self._writer, name="mux-tx", daemon=True).start()
+        threading.Thread(target=self._reader, name="mux-rx", daemon=True).start()
+
+    def send_message(self, channel, payload):
+        with self._cond:
+            self._messages[channel].append(payload)
+            self._cond.notify()
+
+    def send_frame(self, payload, flags=0, meta=None):
+        """Queue a frame; replaces (drops) a queued frame that has not started."""
+        if isinstance(payload, SharedFrame):
+            payload.acquire()
+        with self._cond:
+            if self._pending is not None:
+                self.frames_stale += 1
+                _release(self._pending[0])
+            if self.pacer is not None:
+                self.pacer.frame_queued(time.monotonic())
+            self._pending = (payload, flags, meta)
+            self._cond.notify()
+
+    def take_frame_start(self, seq, acked=False):
+        """(start time, meta) of frame seq, or (None, None).
+
+        The receiver acks decoded frames in order and never acks frames it
+        dropped, so an ack also forgets every older frame. Probe replies
+        come straight from the network task, ahead of acks for frames still
+        queued for decoding, so they only take their own entry."""
+        with self._cond:
+            entry = self.frame_start_times.pop(seq, (None, None))
+            if acked:
+                for older in [s for s in self.frame_start_times if s < seq]:
+                    del self.frame_start_times[older]
+        return entry
+
+    def take_pending(self):
+        """Withdraw the queued frame, returning its meta (None if nothing queued)."""
+        with self._cond:
+            pending, self._pending = self._pending, None
+        if pending is None:
+            return None
+        self.frames_stale += 1
+        _release(pending[0])
+        return pending[2]
+
+    def wait_idle(self, timeout=1.0):
+        """Wait until queued frames have been handed to the kernel."""
+        deadline = time.monotonic() + timeout
+        while not self.closed and time.monotonic() < deadline:
+            with self._cond:
+                if self._pending is None and self._frame is None:
+                    return
+            time.sleep(0.005)
+
+    def tcp_info(self):
+        """(smoothed RTT ms, RTT variance ms, total retransmits) or None."""
+        try:
+            info = TCP_INFO_STRUCT.unpack(
+                self.sock.getsockopt(socket.IPPROTO_TCP, TCP_INFO, TCP_INFO_STRUCT.size))
+        except (OSError, struct.error):
+            return None
+        return info[TCPI_RTT] / 1000.0, info[TCPI_RTTVAR] / 1000.0, info[TCPI_TOTAL_RETRANS]
+
+    def close(self):
+        with self._cond:
+            if self.closed:
+                return
+            self.closed = True
+            self._cond.notify_all()
+        try:
+            self.sock.shutdown(socket.SHUT_RDWR)
+        except OSError:
+            pass
+        self.sock.close()
+        # Pages of a closed socket are no longer referenced by the kernel
+        with self._cond:
+            for _, frame in self._zc_inflight:
+                _release(frame)
+            self._zc_inflight.clear()
+            if self._pending is not None:
+                _release(self._pending[0])
+                self._pending = None
+            _release(self._frame_obj)
+            self._frame_obj = None
+
+    def _next_packet(self):
+        for channel, queue in self._messages.items():
+            if queue:
+                return proto.packet(channel, queue.popleft())
+
+        if self._frame is None and self._pending is not None:
+            payload, self._frame_flags, self._frame_meta = self._pending
+            self._frame_obj = payload
+            self._frame = payload.view if isinstance(payload, SharedFrame) else memoryview(payload)
+            self._pending = None
+            self._offset = 0
+            if self.pacer is not None:
+                self.pacer.frame_started(len(self._frame), time.monotonic())
+        if self._frame is None:
+            return None
+        if self.pacer is not None:
+            wait = self.pacer.wait(time.monotonic())
+            if wait > 0:
+                self._pace_wait = wait
+                return None
+
+        if self.zerocopy:
+            return self._next_gather()
+        return proto.packet(proto.CH_VIDEO, *self._next_chunk(copy=True))
+
+    def _next_chunk(self, copy):
+        """(chunk, flags) of the current frame; notes the frame once it is done."""
+        flags = 0
+        if self._offset == 0:
+            flags |= proto.FLAG_FRAME_START | self._frame_flags
+            self.frame_start_times[self.frames_sent + 1] = (time.monotonic(), self._frame_meta)
+        end = min(len(self._frame), self._offset + self.chunk)
+        payload = self._frame[self._offset:end]
+        if copy:
+            payload = bytes(payload)
+        self._offset = end
+        if self.pacer is not None:
+            self.pacer.sent(len(payload), time.monotonic())
+        if end == len(self._frame):
+            flags |= proto.FLAG_FRAME_END
+            self._frame = None
+            self._finished, self._frame_obj = self._frame_obj, None
+            self.frames_sent += 1
+        return payload, flags
+
+    def _next_gather(self):
+        """Header and chunk buffers for one sendmsg, up to ZEROCOPY_BATCH of
+        video unless pacing or a queued message needs the next slot."""
+        buffers = []
+        size = 0
+        while self._frame is not None and size < ZEROCOPY_BATCH:
+            payload, flags = self._next_chunk(copy=False)
+            buffers += (proto.MUX_HEADER.pack(proto.CH_VIDEO, flags, len(payload)), payload)
+            size += len(payload)
+            if self.pacer is not None or any(self._messages.values()):
+                break
+        return buffers
+
+    def _send(self, packet):
+        """Send a packet or gathered buffers; returns the bytes written."""
+        if isinstance(packet, bytes):
+            self.sock.sendall(packet)
+            return len(packet)
+        total = sum(len(b) for b in packet)
+        try:
+            sent = self.sock.sendmsg(packet, [], self._zc_flags)
+            if self._zc_flags and sent > 0:
+                # The kernel references the headers' pages too
+                with self._cond:
+                    self._zc_inflight.append((self._zc_next, packet))
+                self._zc_next += 1
+                self.zc_sends += 1
+        except OSError as e:
+            if e.errno != errno.ENOBUFS:
+                raise
+            sent = self.sock.sendmsg(packet)  # Out of optmem for pinned pages: copy
+        if sent < total:
+            self.sock.sendall(b"".join(bytes(b) for b in packet)[sent:])
+        return total
+
+    def _frame_done(self, frame):
+        """The last chunk of `frame` was handed to the kernel."""
+        if self._zc_flags:
+            # The kernel may still read the pages: keep the buffer alive
+            with self._cond:
+                self._zc_inflight.append((self._zc_next - 1, frame))
+        else:
+            _release(frame)
+
+    def _reap_completions(self):
+        """Release frames whose zero-copy sends the kernel has completed."""
+        while self._zc_inflight:
+            try:
+                _, ancdata, _, _ = self.sock.recvmsg(0, 1024, MSG_ERRQUEUE | socket.MSG_DONTWAIT)
+            except (BlockingIOError, InterruptedError):
+                return
+            for level, kind, data in ancdata:
+                if (level, kind) not in RECVERR_LEVELS or len(data) < SOCK_EXTENDED_ERR.size:
+                    continue
+                _, origin, _, code, _, first, last = SOCK_EXTENDED_ERR.unpack(data[:SOCK_EXTENDED_ERR.size])
+                if origin != SO_EE_ORIGIN_ZEROCOPY:
+                    continue
+                if code & SO_EE_CODE_ZEROCOPY_COPIED:
+                    self.zc_copied += last - first + 1
+                with self._cond:
+                    while self._zc_inflight and _zc_before(self._zc_inflight[0][0], last):
+                        _release(self._zc_inflight.popleft()[1])
+
+    def _writer(self):
+        try:
+            while True:
+                with self._cond:
+                    packet = self._next_packet()
+                    while packet is None and not self.closed:
+                        # Paced video wakes up on time; messages wake it early.
+                        # Pending zero-copy completions are polled meanwhile.
+                        wait, self._pace_wait = self._pace_wait, None
+                        if self._zc_inflight:
+                            wait = min(wait or 0.02, 0.02)
+                        self._cond.wait(wait)
+                        if self._zc_inflight:
+                            self._cond.release()
+                            try:
+                                self._reap_completions()
+                            finally:
+                                self._cond.acquire()
+                        packet = self._next_packet()
+                    if self.closed:
+                        return
+                    finished, self._finished = self._finished, None
+                self.bytes_sent += self._send(packet)
+                if finished is not None:
+                    self._frame_done(finished)
+                if self._zc_inflight:
+                    self._reap_completions()
+        except OSError:
+            self.close()
+
+    def _recv_exact(self, n):
+        buf = bytearray()
+        while len(buf) < n:
+            data = self.sock.recv(n - len(buf))
+            if not data:
+                raise ConnectionError("receiver closed the connection")
+            buf += data
+        return bytes(buf)
+
+    def _reader(self):
+        try:
+            while not self.closed:
+                channel, _, length = proto.MUX_HEADER.unpack(self._recv_exact(proto.MUX_HEADER.size))
+                payload = self._recv_exact(length)
+                if self.on_message:
+                    self.on_message(channel, payload)
+        except (OSError, ConnectionError):
+            self.close()
+
+
+def _discard_receiver(listener, count, done):
+    """Accept `count` connections and read everything they send."""
+    import selectors
+
+    selector = selectors.DefaultSelector()
+    for _ in range(count):
+        sock, _ = listener.accept()
+        sock.setblocking(False)
+        selector.register(sock, selectors.EVENT_READ)
+    listener.close()
+    open_socks = count
+    while open_socks:
+        for key, _ in selector.select():
+            try:
+                data = key.fileobj.recv(1 << 18)
+            except BlockingIOError:
+                continue
+            if not data:
+                selector.unregister(key.fileobj)
+                key.fileobj.close()
+                open_socks -= 1
+    done.set()
+
+
+def bench_fanout(receivers, frame_bytes, frames, zerocopy):
+    """Sender CPU seconds per delivered MB sending `frames` frames to local
+    receivers, plus (zero-copy sends, sends the kernel copied anyway).
+
+    The receivers run in another process so only the sender's CPU is
+    counted; each frame is queued once every receiver has started the
+    previous one, so none are dropped as stale.
+    """
+    import multiprocessing
+    import os
+
+    listener = socket.socket()
+    listener.bind(("127.0.0.1", 0))
+    listener.listen(receivers)
+    done = multiprocessing.Event()
+    receiver = multiprocessing.Process(target=_discard_receiver, args=(listener, receivers, done),
+                                       daemon=True)
+    receiver.start()
+    port = listener.getsockname()[1]
+    conns = [MuxConnection("127.0.0.1", port, zerocopy=zerocopy) for _ in range(receivers)]
+    listener.close()
+
+    pool = FramePool() if zerocopy else None
+    payload = os.urandom(frame_bytes)
+    start = time.process_time()
+    for _ in range(frames):
+        while any(conn._pending is not None for conn in conns):
+            time.sleep(0.0002)
+        fan_out(conns, payload, pool)
+    for conn in conns:
+        conn.wait_idle(timeout=10.0)
+        # Let the last completions arrive before the sockets go away
+        deadline = time.monotonic() + 1.0
+        while conn._zc_inflight and time.monotonic() < deadline:
+            time.sleep(0.001)
+    cpu_s = time.process_time() - start
+    delivered = sum(conn.bytes_sent for conn in conns)
+    sends = sum(conn.zc_sends for conn in conns)
+    copied = sum(conn.zc_copied for conn in conns)
+    for conn in conns:
+        conn.close()
+    done.wait(10.0)
+    receiver.join(1.0)
+    return cpu_s / (delivered / 1e6), sends, copied
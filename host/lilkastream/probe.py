@@ -0,0 +1,201 @@
+"""Connect-time probing of link goodput and device decode speed.
+
+Right after connecting, the sender sends padding frames (FLAG_PROBE) that
+the receiver counts and times, then a few test frames at different JPEG
+qualities whose acks carry the decode time. The result seeds the initial
+quality and frame rate, so a weak link does not start out overflowing and a
+strong one does not start out blurry.
+"""
+
+import io
+import threading
+import time
+
+from . import protocol as proto
+from .log import log
+
+# Padding bursts; a burst is only sent when the previous one finished
+# quickly, and is capped to about PROBE_BURST_SECONDS of the measured rate
+PROBE_BURSTS = (32 * 1024, 128 * 1024)
+PROBE_BURST_SECONDS = 0.4
+PROBE_QUALITIES = (30, 50, 80)
+
+# Typical 280x240 desktop frames (bytes, decode ms), used when the test
+# frames cannot be encoded (no Pillow) or are not acked
+TYPICAL = {30: (1200, 15.0), 50: (2400, 20.0), 80: (5000, 30.0)}
+
+QUALITY_STEPS = (30, 40, 50, 60, 70, 80)
+FPS_STEPS = (5, 10, 15, 20, 25, 30)
+BASE_FPS = 15
+HEADROOM = 0.6        # Fraction of probed goodput the stream may use
+DECODE_BUDGET = 0.85  # Fraction of the frame interval decode may use
+
+
+def test_pattern(width, height):
+    """Desktop-like test frame: window chrome, text lines and a gradient."""
+    import random
+
+    from PIL import Image, ImageDraw
+
+    rng = random.Random(0)
+    img = Image.new("RGB", (width, height), (236, 236, 236))
+    draw = ImageDraw.Draw(img)
+    draw.rectangle((0, 0, width, 14), fill=(48, 72, 120))
+    draw.text((4, 2), "lilka probe", fill=(255, 255, 255))
+    for y in range(22, height // 2, 10):
+        words = " ".join("".join(rng.choice("abcdefghijklmnopqrstuvwxyz") for _ in range(rng.randint(2, 8)))
+                         for _ in range(8))
+        draw.text((6, y), words, fill=(20, 20, 20))
+    for y in range(height // 2, height):
+        for x in range(0, width, 4):
+            draw.rectangle((x, y, x + 3, y), fill=((x * 255) // width, (y * 3) % 256, (x + y) % 256))
+    return img
+
+
+def encode_test_frames(width, height):
+    """JPEG test frames per PROBE_QUALITIES, or None without Pillow."""
+    try:
+        img = test_pattern(width, height)
+    except ImportError:
+        return None
+    frames = {}
+    for quality in PROBE_QUALITIES:
+        out = io.BytesIO()
+        img.save(out, "JPEG", quality=quality, subsampling="4:2:0")
+        frames[quality] = out.getvalue()
+    return frames
+
+
+class ProbeResult:
+    def __init__(self):
+        self.goodput_kbps = None
+        self.rtt_ms = None
+        self.samples = {}   # quality -> (bytes, decode ms)
+        self.elapsed = 0.0
+
+    def estimate(self, quality):
+        """(bytes, decode ms) at `quality`, interpolated between samples."""
+        samples = self.samples or TYPICAL
+        points = sorted(samples.items())
+        if quality <= points[0][0]:
+            return points[0][1]
+        for (q0, (b0, d0)), (q1, (b1, d1)) in zip(points, points[1:]):
+            if quality <= q1:
+                t = (quality - q0) / (q1 - q0)
+                return b0 + t * (b1 - b0), d0 + t * (d1 - d0)
+        return points[-1][1]
+
+    def fits(self, quality, fps, scale=1.0):
+        """Whether `quality` at `fps` fits; `scale` is the fraction of pixels sent."""
+        nbytes, decode_ms = self.estimate(quality)
+        return nbytes * scale * 8 * fps / 1000.0 <= HEADROOM * self.goodput_kbps and \
+            decode_ms * scale <= DECODE_BUDGET * 1000.0 / fps
+
+    def choose(self, max_fps, default_quality, default_fps):
+        """Initial (quality, fps): best quality at BASE_FPS, then as much fps as that allows."""
+        if self.goodput_kbps is None:
+            return default_quality, default_fps
+        steps = [f for f in FPS_STEPS if f <= max_fps] or [max_fps]
+        base = max([f for f in steps if f <= BASE_FPS] or steps[:1])
+        for fps in sorted((f for f in steps if f <= base), reverse=True):
+            quality = next((q for q in reversed(QUALITY_STEPS) if self.fits(q, fps)), None)
+            if quality is not None:
+                break
+        else:
+            return QUALITY_STEPS[0], steps[0]
+        for faster in (f for f in steps if f > fps):
+            if not self.fits(quality, faster):
+                break
+            fps = faster
+        return quality, fps
+
+
+    def choose_layer(self, ladder, fps, size):
+        """Highest simulcast layer that fits at `fps`, or None."""
+        if self.goodput_kbps is None:
+            return None
+        pixels = size[0] * size[1]
+        for layer in range(len(ladder) - 1, -1, -1):
+            quality, layer_size = ladder.layers[layer]
+            scale = layer_size[0] * layer_size[1] / pixels if layer_size else 1.0
+            if self.fits(quality, fps, scale):
+                return layer
+        return None
+
+
+class Prober:
+    """Runs the probe on one session before streaming starts."""
+
+    def __init__(self, session, timeout=2.0):
+        self.session = session
+        self.timeout = timeout
+        self._event = threading.Event()
+        self._reply = None
+
+    def _on_probe(self, nbytes, us):
+        self._reply = (nbytes, us)
+        self._event.set()
+
+    def _on_ack(self, meta, size, decode_us, latency):
+        if isinstance(meta, tuple) and meta[0] == "probe":
+            self._reply = (meta[1], size, decode_us)
+            self._event.set()
+
+    def _send(self, payload, flags, meta):
+        self._event.clear()
+        self._reply = None
+        self.session.conn.send_frame(payload, flags, meta)
+        if not self._event.wait(self.timeout) or self.session.conn.closed:
+            return None
+        return self._reply
+
+    def run(self, width, height):
+        session = self.session
+        result = ProbeResult()
+        start = time.monotonic()
+        prev_probe, prev_ack = session.on_probe, session.on_ack
+        session.on_probe, session.on_ack = self._on_probe, self._on_ack
+        try:
+            size = PROBE_BURSTS[0]
+            for burst in PROBE_BURSTS:
+                reply = self._send(bytes(min(burst, size)), proto.FLAG_PROBE, "probe")
+                if reply is None:
+                    log(f"{session.name}Probe: no reply from receiver, keeping defaults")
+                    return result
+                nbytes, us = reply
+                result.goodput_kbps = nbytes * 8000.0 / max(us, 1)
+                # Size the next burst to the measured rate; TCP has warmed up by now
+                size = int(result.goodput_kbps * 1000 / 8 * PROBE_BURST_SECONDS)
+                if size <= nbytes:
+                    break
+
+            for quality, jpeg in (encode_test_frames(width, height) or {}).items():
+                reply = self._send(jpeg, 0, ("probe", quality))
+                if reply is not None:
+                    result.samples[quality] = (reply[1], reply[2] / 1000.0)
+        finally:
+            session.on_probe, session.on_ack = prev_probe, prev_ack
+            result.elapsed = time.monotonic() - start
+
+        rtt = session.rtt_snapshot()
+        result.rtt_ms = min(rtt) if rtt else None
+        measured = ", ".join(f"q{q} {b / 1024:.1f} KB {d:.1f} ms" for q, (b, d) in sorted(result.samples.items()))
+        log(f"{session.name}Probe: goodput {result.goodput_kbps:.0f} kbps"
+            f"{f', RTT {result.rtt_ms:.1f} ms' if result.rtt_ms is not None else ''}"
+            f" | {measured or 'typical frame sizes'} | {result.elapsed:.2f} s")
+        return result
+
+
+def probe_sessions(sessions, width, height):
+    """Probe all receivers in parallel; returns results in session order."""
+    results = [None] * len(sessions)
+
+    def worker(i):
+        results[i] = Prober(sessions[i]).run(width, height)
+
+    threads = [threading.Thread(target=worker, args=(i,), daemon=True) for i in range(len(sessions))]
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join()
+    return results
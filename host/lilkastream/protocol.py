@@ -0,0 +1,71 @@
+"""Multiplexed stream protocol (mirrors include/stream_protocol.h).
+
+A connection starts with MUX_MAGIC and then carries packets:
+    [channel:u8][flags:u8][length:u16 LE][payload...]
+Lower channel numbers have higher priority.
+"""
+
+import socket
+import struct
+
+MUX_MAGIC = b"LMX1"
+MUX_HEADER = struct.Struct("<BBH")
+MUX_VIDEO_CHUNK = 1024
+
+CH_CONTROL = 0
+CH_CURSOR = 1
+CH_INPUT = 2
+CH_TELEMETRY = 3
+CH_VIDEO = 4
+CHANNELS = (CH_CONTROL, CH_CURSOR, CH_INPUT, CH_TELEMETRY, CH_VIDEO)
+
+FLAG_FRAME_START = 0x01
+FLAG_FRAME_END = 0x02
+FLAG_TILED = 0x04
+FLAG_PROBE = 0x08  # Padding frame for bandwidth probing
+
+TILE_HEADER = struct.Struct("<BHHHHI")  # codec, x, y, w, h, length
+TILE_CODEC_JPEG = 0
+TILE_CODEC_PALETTE = 1
+TILE_CODEC_RAW565 = 2
+TILE_CODEC_COUNT = 3
+
+CTRL_PING = 0x01
+CTRL_PONG = 0x02
+CTRL_REFRESH = 0x03
+CTRL_RELAY = 0x04
+
+CURSOR_POS = 0x01
+
+INPUT_BUTTON = 0x01
+BUTTON_NAMES = ("up", "down", "left", "right", "a", "b", "c", "d", "select", "start")
+
+TELEM_FRAME_ACK = 0x01
+TELEM_TILE_STATS = 0x02
+TELEM_STATS = 0x03
+TELEM_PROBE = 0x04
+
+PING = struct.Struct("<BII")            # type, seq, host timestamp (us)
+CURSOR = struct.Struct("<Bhhb")         # type, x, y, visible
+INPUT = struct.Struct("<BBB")           # type, button, pressed
+FRAME_ACK = struct.Struct("<BIIII")     # type, seq, size, queue us, decode us
+# type, fps x10, kbps, decode p50/p90/p99 us, dropped, rssi, queue depth,
+# reconnects, frames decoded, uptime s
+DEVICE_STATS = struct.Struct("<BHHIIIIbBHII")
+PROBE = struct.Struct("<BIII")          # type, seq, bytes, us from first to last chunk
+TILE_STATS = struct.Struct("<BI" + "HI" * TILE_CODEC_COUNT)  # type, seq, (tiles, us) per codec
+
+
+RELAY_MAX_NODES = 10
+RELAY_HEADER = struct.Struct("<BBBB")   # type, fan-out, node index, count
+RELAY_ENTRY = struct.Struct("<4sH")     # IPv4 address, port
+
+
+def relay_message(fanout, nodes):
+    """CTRL_RELAY for node 0; nodes are the (ipv4, port) of nodes 1..n."""
+    return RELAY_HEADER.pack(CTRL_RELAY, fanout, 0, len(nodes)) + b"".join(
+        RELAY_ENTRY.pack(socket.inet_aton(ip), port) for ip, port in nodes)
+
+
+def packet(channel, payload, flags=0):
+    return MUX_HEADER.pack(channel, flags, len(payload)) + payload
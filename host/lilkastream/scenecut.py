@@ -0,0 +1,150 @@
+"""Scene-cut detection and a temporary quality/resolution budget for cut frames.
+
+A hard cut replaces the whole picture. With --tiles, where a steady scene
+only sends the tiles that change, the cut frame carries every tile at once
+and backs up the link and the decoder for the frames behind it; plain JPEG
+streams see a smaller jump whenever the new scene is busier. Viewers barely
+see detail in the first frames after a cut, so the cut frame is encoded
+cheaply and detail comes back over the next few frames:
+  - plain JPEG: the cut frame at a lower quality (or at half resolution,
+    which the receiver upscales), then quality ramps back;
+  - tiles: the cut frame at a lower quality, then each following frame
+    re-sends an interleaved share of the tiles at full quality.
+
+Detection works on a thumbnail of every 8th pixel. A cut needs both a large
+mean absolute difference (SAD) from the previous thumbnail and a changed
+luma histogram: pans and scrolling move the content, so their SAD is high,
+but they keep its histogram and do not count as cuts.
+"""
+
+import numpy as np
+
+from .frames import encode_jpeg, resize
+from .stats import percentile
+
+THUMB_STEP = 8
+HIST_BINS = 32
+
+
+class SceneCutDetector:
+    def __init__(self, threshold=30.0, hist_threshold=0.3):
+        self.threshold = threshold            # Mean |difference| per channel, 0-255
+        self.hist_threshold = hist_threshold  # Histogram change, 0-1
+        self.prev = None
+        self.prev_hist = None
+
+    def is_cut(self, rgb):
+        thumb = rgb[::THUMB_STEP, ::THUMB_STEP].astype(np.int16)
+        luma = thumb.sum(axis=2) // 3
+        hist = np.bincount(luma.ravel() * HIST_BINS // 256, minlength=HIST_BINS) / luma.size
+        prev, prev_hist = self.prev, self.prev_hist
+        self.prev, self.prev_hist = thumb, hist
+        if prev is None or prev.shape != thumb.shape:
+            return False
+
+        sad = float(np.abs(thumb - prev).mean())
+        change = 0.5 * float(np.abs(hist - prev_hist).sum())
+        return sad >= self.threshold and change >= self.hist_threshold
+
+
+class SceneCutBudget:
+    """Per-frame quality and size around detected cuts.
+
+    mode "quality": the cut frame is encoded at `cut_scale` of the quality.
+    mode "resolution": the cut frame is encoded at half size instead.
+    Either way quality then ramps back to the base over `recover` frames.
+    """
+
+    def __init__(self, mode="quality", recover=4, cut_scale=0.4, min_quality=10):
+        self.mode = mode
+        self.recover = recover
+        self.cut_scale = cut_scale
+        self.min_quality = min_quality
+        self.detector = SceneCutDetector()
+        self.since_cut = None
+        self.cuts = 0
+
+    def plan(self, rgb, quality):
+        """(quality, size or None) for this frame."""
+        if self.detector.is_cut(rgb):
+            self.since_cut = 0
+            self.cuts += 1
+        if self.since_cut is None or self.since_cut > self.recover:
+            return quality, None
+        since, self.since_cut = self.since_cut, self.since_cut + 1
+        low = max(self.min_quality, int(quality * self.cut_scale))
+        if self.mode == "resolution":
+            if since == 0:
+                return quality, (rgb.shape[1] // 2, rgb.shape[0] // 2)
+            low = (low + quality) // 2  # Already had a cheap frame
+        return low + (quality - low) * since // (self.recover + 1), None
+
+    def encode(self, rgb, quality):
+        frame_quality, size = self.plan(rgb, quality)
+        return encode_jpeg(resize(rgb, size) if size else rgb, frame_quality)
+
+    def plan_tiles(self, rgb, quality, tile_count):
+        """(quality, tiles to re-send) for a tiled frame."""
+        if self.detector.is_cut(rgb):
+            self.since_cut = 0
+            self.cuts += 1
+            return max(self.min_quality, int(quality * self.cut_scale)), set()
+        if self.since_cut is None or self.since_cut >= self.recover:
+            return quality, set()
+        self.since_cut += 1
+        return quality, set(range(self.since_cut - 1, tile_count, self.recover))
+
+
+class _Pipeline:
+    """Receiver as two pipelined stages, the link and the decoder."""
+
+    def __init__(self, us_per_byte):
+        self.us_per_byte = us_per_byte
+        self.link_free = self.decoder_free = 0.0
+
+    def latency(self, arrival, nbytes, decode_us):
+        self.link_free = max(arrival, self.link_free) + nbytes * self.us_per_byte
+        self.decoder_free = max(self.link_free, self.decoder_free) + decode_us
+        return self.decoder_free - arrival
+
+
+def bench_scene_cuts(frames, quality, mode, link_kbps, fps, tiles=False):
+    """Per-frame (bytes, predicted decode us, latency us) without and with the
+    cut budget, plus the indices of detected cuts.
+
+    Frames arrive one per 1/fps and wait for the ones ahead of them, so a
+    burst of heavy frames shows up as latency on the frames after it.
+    """
+    from .camera import parse_headers
+    from .tiles import DecodeModel, TileEncoder
+
+    model = DecodeModel()
+    height, width = frames[0].shape[:2]
+    budget = SceneCutBudget(mode)
+    runs = {"plain": [], "cut budget": []}
+    pipelines = {name: _Pipeline(8000.0 / link_kbps) for name in runs}
+    if tiles:
+        encoders = {name: TileEncoder(width, height, quality, link_kbps, model=model) for name in runs}
+    cuts = []
+    for i, rgb in enumerate(frames):
+        before = budget.cuts
+        for name in runs:
+            if tiles:
+                encoder = encoders[name]
+                if name != "plain":
+                    encoder.quality, refresh = budget.plan_tiles(rgb, quality, len(encoder.rects))
+                    encoder.mark_dirty(refresh)
+                payload, _, _, decode = encoder.encode(rgb)
+            else:
+                payload = encode_jpeg(rgb, quality) if name == "plain" else budget.encode(rgb, quality)
+                info = parse_headers(payload)
+                decode = model.frame_us(info.width * info.height, len(payload), width * height)
+            latency = pipelines[name].latency(i * 1e6 / fps, len(payload), decode)
+            runs[name].append((len(payload), decode, latency))
+        if budget.cuts != before:
+            cuts.append(i)
+    return runs, cuts
+
+
+def distribution(values, percentiles=(50, 90, 99, 100)):
+    return [percentile(values, p) for p in percentiles]
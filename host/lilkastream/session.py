@@ -0,0 +1,150 @@
+"""Per-receiver session state: acks, pongs, telemetry and input events."""
+
+import collections
+import threading
+import time
+
+from . import protocol as proto
+from .log import log
+from .stats import percentile
+
+# Control RTTs the metrics exporter takes its quantiles from; report() clears
+# rtt_ms every stats interval, so the exporter keeps its own window
+RTT_WINDOW = 64
+
+
+class Session:
+    def __init__(self, name="", target=""):
+        self.name = name
+        self.target = target
+        self.device = None       # Latest TELEM_STATS as a dict
+        self.device_time = 0.0
+        self.lock = threading.Lock()
+        self.conn = None
+        self.on_refresh = None
+        self.on_ack = None  # (frame meta, size, decode us, latency ms)
+        self.on_probe = None  # (bytes, us) measured by the receiver
+        self.encoder = None
+        self.controller = None
+        self.ping_seq = 0
+        self.rtt_ms = []
+        self.rtt_recent = collections.deque(maxlen=RTT_WINDOW)
+        self.rtt_sum_ms = 0.0
+        self.rtt_count = 0
+        self.acks = 0
+        self.acks_total = 0
+        self.stable_at = None    # When the stream first ran without drops
+        self._window_good = None
+        self._window_acks = 0
+        self.retransmits = 0
+        self.decode_us = 0
+        self.latency_ms = []
+        self.tile_tiles = [0] * proto.TILE_CODEC_COUNT
+        self.tile_us = [0] * proto.TILE_CODEC_COUNT
+
+    def on_message(self, channel, payload):
+        if not payload:
+            return
+        kind = payload[0]
+        now = time.monotonic()
+        if channel == proto.CH_CONTROL and kind == proto.CTRL_PONG:
+            _, _, sent_us = proto.PING.unpack(payload[:proto.PING.size])
+            rtt_us = (int(now * 1e6) - sent_us) & 0xFFFFFFFF
+            rtt_ms = rtt_us / 1000.0
+            with self.lock:
+                self.rtt_ms.append(rtt_ms)
+                self.rtt_recent.append(rtt_ms)
+                self.rtt_sum_ms += rtt_ms
+                self.rtt_count += 1
+        elif channel == proto.CH_CONTROL and kind == proto.CTRL_REFRESH:
+            if self.on_refresh:
+                self.on_refresh()
+        elif channel == proto.CH_TELEMETRY and kind == proto.TELEM_FRAME_ACK:
+            _, seq, size, _, decode_us = proto.FRAME_ACK.unpack(payload[:proto.FRAME_ACK.size])
+            started, meta = self.conn.take_frame_start(seq, acked=True)
+            latency = (now - started) * 1000.0 if started is not None else None
+            with self.lock:
+                self.acks += 1
+                self.acks_total += 1
+                self.decode_us += decode_us
+                if latency is not None:
+                    self.latency_ms.append(latency)
+            if self.on_ack:
+                self.on_ack(meta, size, decode_us, latency)
+        elif channel == proto.CH_TELEMETRY and kind == proto.TELEM_PROBE:
+            _, seq, nbytes, us = proto.PROBE.unpack(payload[:proto.PROBE.size])
+            self.conn.take_frame_start(seq)
+            if self.on_probe:
+                self.on_probe(nbytes, us)
+        elif channel == proto.CH_TELEMETRY and kind == proto.TELEM_STATS:
+            (_, fps_x10, kbps, p50, p90, p99, dropped, rssi, queue,
+             reconnects, decoded, uptime) = proto.DEVICE_STATS.unpack(payload[:proto.DEVICE_STATS.size])
+            self.device = {
+                "fps": fps_x10 / 10.0, "kbps": kbps, "decode_p50_us": p50, "decode_p90_us": p90,
+                "decode_p99_us": p99, "dropped": dropped, "rssi": rssi, "queue_depth": queue,
+                "reconnects": reconnects, "decoded": decoded, "uptime": uptime,
+            }
+            self.device_time = now
+        elif channel == proto.CH_TELEMETRY and kind == proto.TELEM_TILE_STATS:
+            fields = proto.TILE_STATS.unpack(payload[:proto.TILE_STATS.size])
+            with self.lock:
+                for codec in range(proto.TILE_CODEC_COUNT):
+                    self.tile_tiles[codec] += fields[2 + codec * 2]
+                    self.tile_us[codec] += fields[3 + codec * 2]
+        elif channel == proto.CH_INPUT and kind == proto.INPUT_BUTTON:
+            _, button, pressed = proto.INPUT.unpack(payload[:proto.INPUT.size])
+            name = proto.BUTTON_NAMES[button] if button < len(proto.BUTTON_NAMES) else str(button)
+            log(f"{self.name}Input: {name} {'pressed' if pressed else 'released'}")
+
+    def check_stable(self, window_start, sent, stale):
+        """Note when the stream first ran two 1 s windows without drops.
+
+        A window is good when every frame sent was delivered to the decoder
+        (acked, allowing one in flight) and none went stale at the sender.
+        """
+        with self.lock:
+            acks = self.acks_total - self._window_acks
+            self._window_acks = self.acks_total
+        if self.stable_at is not None:
+            return
+        good = sent > 0 and stale == 0 and acks >= sent - 1
+        if good and self._window_good is not None:
+            self.stable_at = self._window_good
+            log(f"{self.name}Stream stable {self.stable_at - self.conn.connected_at:.1f} s after connect")
+        self._window_good = window_start if good else None
+
+    def rtt_snapshot(self):
+        """Last RTT_WINDOW control RTTs (ms), and the sum and count of all."""
+        with self.lock:
+            return list(self.rtt_recent), self.rtt_sum_ms, self.rtt_count
+
+    def ping(self):
+        self.ping_seq += 1
+        stamp = int(time.monotonic() * 1e6) & 0xFFFFFFFF
+        self.conn.send_message(proto.CH_CONTROL, proto.PING.pack(proto.CTRL_PING, self.ping_seq, stamp))
+
+    def report(self, elapsed, frames, nbytes, stale):
+        with self.lock:
+            rtt, self.rtt_ms = self.rtt_ms, []
+            lat, self.latency_ms = self.latency_ms, []
+            acks, self.acks = self.acks, 0
+            decode_us, self.decode_us = self.decode_us, 0
+            tile_tiles, self.tile_tiles = self.tile_tiles, [0] * proto.TILE_CODEC_COUNT
+            tile_us, self.tile_us = self.tile_us, [0] * proto.TILE_CODEC_COUNT
+        avg_decode = decode_us / acks / 1000.0 if acks else 0.0
+        tcp = ""
+        info = self.conn.tcp_info()
+        if info is not None:
+            srtt, rttvar, retransmits = info
+            tcp = f" | TCP srtt {srtt:.1f} ms var {rttvar:.1f} ms, {retransmits - self.retransmits} retrans"
+            self.retransmits = retransmits
+        log(f"{self.name}TX: {frames / elapsed:.1f} fps, {nbytes * 8 / elapsed / 1000:.1f} kbps, {stale} stale"
+            f" | ACK: {acks / elapsed:.1f} fps, decode {avg_decode:.1f} ms,"
+            f" e2e p50 {percentile(lat, 50):.1f} ms"
+            f" | ctrl RTT p50 {percentile(rtt, 50):.1f} ms p99 {percentile(rtt, 99):.1f} ms"
+            f" max {max(rtt, default=0):.1f} ms{tcp}")
+        if any(tile_tiles):
+            names = ("jpeg", "palette", "raw565")
+            parts = ", ".join(f"{names[c]} {tile_tiles[c]} tiles {tile_us[c] / 1000.0:.1f} ms"
+                              for c in range(proto.TILE_CODEC_COUNT))
+            log(f"{self.name}Device tile decode: {parts}")
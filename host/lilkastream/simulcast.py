@@ -0,0 +1,158 @@
+"""Simulcast quality ladder: one capture encoded at several qualities.
+
+Every receiver is assigned the highest layer its measured throughput and
+decode speed sustain. Layers switch only between frames, since each frame
+is sent whole from a single layer. A layer may also have a lower resolution
+(e.g. 30@140x120); the receiver upscales and letterboxes it, so dropping to
+it trades sharpness for frame rate without reconnecting.
+"""
+
+import time
+from concurrent.futures import ThreadPoolExecutor
+
+from .frames import encode_jpeg, parse_size, resize
+from .log import log
+
+# How often layers nobody uses are still encoded to keep size estimates fresh
+IDLE_LAYER_SAMPLE = 15
+
+
+def parse_layers(text):
+    """"30@140x120,50,80" -> [(30, (140, 120)), (50, None), (80, None)]."""
+    layers = []
+    for item in text.split(","):
+        quality, _, size = item.partition("@")
+        layers.append((int(quality), parse_size(size) if size else None))
+    return layers
+
+
+def encode_layer(rgb, quality, size):
+    return encode_jpeg(resize(rgb, size) if size else rgb, quality)
+
+
+class Ladder:
+    def __init__(self, layers, fps):
+        # Cheapest first: lower resolutions, then lower qualities
+        self.layers = sorted(layers, key=lambda l: (l[1][0] * l[1][1] if l[1] else float("inf"), l[0]))
+        self.qualities = [quality for quality, _ in self.layers]
+        self.fps = fps
+        self.avg_size = [0.0] * len(self.qualities)
+        self.frames = 0
+        # Pillow releases the GIL while encoding, so layers encode in parallel
+        self.executor = ThreadPoolExecutor(max_workers=len(self.qualities))
+
+    def __len__(self):
+        return len(self.qualities)
+
+    def encode(self, rgb, active):
+        """Encode the layers in `active` (plus periodic samples of the rest)."""
+        self.frames += 1
+        wanted = set(active)
+        if self.frames % IDLE_LAYER_SAMPLE == 1:
+            wanted = set(range(len(self.qualities)))
+        futures = {layer: self.executor.submit(encode_layer, rgb, *self.layers[layer])
+                   for layer in wanted}
+        out = {layer: f.result() for layer, f in futures.items()}
+        for layer, jpeg in out.items():
+            avg = self.avg_size[layer]
+            self.avg_size[layer] = len(jpeg) if avg == 0 else 0.9 * avg + 0.1 * len(jpeg)
+        return out
+
+    def kbps(self, layer):
+        return self.avg_size[layer] * 8 * self.fps / 1000.0
+
+    def layer_for(self, quality):
+        """Highest layer at or below `quality` (the lowest layer if none is)."""
+        return max([i for i, q in enumerate(self.qualities) if q <= quality], default=0)
+
+    def describe(self, layer):
+        quality, size = self.layers[layer]
+        return f"q{quality}@{size[0]}x{size[1]}" if size else f"q{quality}"
+
+
+class LayerController:
+    """Chooses a layer for one receiver from its acks and stale-frame drops."""
+
+    UP_AFTER = 3.0        # Seconds of healthy streaming before trying a higher layer
+    HEADROOM = 0.85       # Fraction of measured throughput a layer may use
+
+    def __init__(self, ladder, name="", layer=0):
+        self.ladder = ladder
+        self.name = name
+        self.layer = layer
+        self.decode_ms = [0.0] * len(ladder)
+        self.acked_bytes = 0
+        self.latency_ms = []
+        self.min_latency = None
+        self.healthy_since = time.monotonic()
+
+    def on_ack(self, layer, size, decode_us, latency_ms):
+        if layer is None:
+            return
+        ms = decode_us / 1000.0
+        avg = self.decode_ms[layer]
+        self.decode_ms[layer] = ms if avg == 0 else 0.8 * avg + 0.2 * ms
+        self.acked_bytes += size
+        if latency_ms is not None:
+            self.latency_ms.append(latency_ms)
+            if self.min_latency is None or latency_ms < self.min_latency:
+                self.min_latency = latency_ms
+
+    def estimate_decode(self, layer):
+        if self.decode_ms[layer]:
+            return self.decode_ms[layer]
+        cur = self.decode_ms[self.layer]
+        cur_size = self.ladder.avg_size[self.layer] or 1
+        # Roughly half of decode time is fixed (IDCT, push), half scales with bytes
+        return cur * (0.5 + 0.5 * self.ladder.avg_size[layer] / cur_size)
+
+    def update(self, elapsed, sent, stale):
+        """Re-evaluate the layer; called periodically by the control loop."""
+        now = time.monotonic()
+        throughput = self.acked_bytes * 8 / elapsed / 1000.0
+        latency = sorted(self.latency_ms)[len(self.latency_ms) // 2] if self.latency_ms else 0
+        self.acked_bytes = 0
+        self.latency_ms = []
+        budget = 1000.0 / self.ladder.fps
+
+        congested = (sent > 0 and stale > 0.1 * sent) or \
+            (self.min_latency is not None and latency > 3 * self.min_latency + 20)
+        too_slow = self.estimate_decode(self.layer) > 0.95 * budget
+
+        target = self.layer
+        if congested or too_slow:
+            target = 0
+            for layer in range(self.layer - 1, -1, -1):
+                if self.ladder.kbps(layer) <= self.HEADROOM * throughput and \
+                        self.estimate_decode(layer) <= 0.9 * budget:
+                    target = layer
+                    break
+            self.healthy_since = now
+        elif now - self.healthy_since >= self.UP_AFTER and self.layer + 1 < len(self.ladder):
+            if self.estimate_decode(self.layer + 1) <= 0.9 * budget:
+                target = self.layer + 1
+            self.healthy_since = now
+
+        if target != self.layer:
+            log(f"{self.name}Layer {self.ladder.describe(self.layer)} -> {self.ladder.describe(target)}"
+                f" (throughput {throughput:.0f} kbps, decode {self.estimate_decode(self.layer):.1f} ms,"
+                f" stale {stale}/{sent})")
+            self.layer = target
+
+
+def bench_layers(frames, layers, fps):
+    """Host CPU per frame for 1..N simultaneously encoded layers."""
+    results = []
+    for count in range(1, len(layers) + 1):
+        ladder = Ladder(layers[:count], fps)
+        active = range(count)
+        ladder.encode(frames[0], active)  # Warm up the pool
+        cpu_start = time.process_time()
+        wall_start = time.monotonic()
+        for rgb in frames:
+            ladder.encode(rgb, active)
+        cpu_ms = (time.process_time() - cpu_start) * 1000.0 / len(frames)
+        wall_ms = (time.monotonic() - wall_start) * 1000.0 / len(frames)
+        ladder.executor.shutdown()
+        results.append((count, cpu_ms, wall_ms))
+    return results
@@ -0,0 +1,179 @@
+"""Per-tile content classification and codec selection.
+
+Each frame is split into tiles. Unchanged tiles are skipped; the rest are
+classified by colour count, edge density and change history, and encoded
+with the candidate codec that minimises bytes plus predicted device decode
+time (converted to bytes at the link rate, since both cost frame time).
+When a plain full-frame JPEG is cheaper than the tile mix, that is sent.
+"""
+
+import struct
+from collections import Counter
+
+import numpy as np
+
+from . import protocol as proto
+from .frames import encode_jpeg, rgb565
+
+TILE_SIZE = 40
+
+CODEC_NAMES = {
+    proto.TILE_CODEC_JPEG: "jpeg",
+    proto.TILE_CODEC_PALETTE: "palette",
+    proto.TILE_CODEC_RAW565: "raw565",
+}
+
+
+class DecodeModel:
+    """Predicted ESP32-S3 decode + SPI push time in microseconds.
+
+    Coefficients were fitted to TJpgDec at 240 MHz and a 80 MHz ST7789 link;
+    they only need to rank codecs correctly, not be exact.
+    """
+
+    push_us_per_px = 0.2
+
+    def tile_us(self, codec, pixels, nbytes, runs=0):
+        if codec == proto.TILE_CODEC_JPEG:
+            decode = 250 + 0.25 * pixels + 0.05 * nbytes
+        elif codec == proto.TILE_CODEC_PALETTE:
+            decode = 20 + 0.04 * pixels + 0.1 * runs
+        else:
+            decode = 10 + 0.01 * pixels
+        return decode + self.push_us_per_px * pixels
+
+    def frame_us(self, pixels, nbytes, display_pixels=None):
+        """A whole JPEG; smaller frames are upscaled to `display_pixels`."""
+        pushed = display_pixels or pixels
+        return 250 + 0.25 * pixels + 0.05 * nbytes + self.push_us_per_px * pushed
+
+
+def encode_palette(tile565):
+    """Palette + RLE payload, or (None, 0) if the tile has over 256 colours."""
+    colors, index = np.unique(tile565.ravel(), return_inverse=True)
+    if len(colors) > 256:
+        return None, 0
+    index = index.astype(np.uint8)
+
+    starts = np.concatenate(([0], np.flatnonzero(np.diff(index)) + 1))
+    lengths = np.diff(np.append(starts, len(index)))
+    # Runs are stored as length-1 in a byte, so split runs longer than 256
+    parts = (lengths + 255) // 256
+    run_index = np.repeat(index[starts], parts)
+    run_length = np.full(int(parts.sum()), 256)
+    run_length[np.cumsum(parts) - 1] = lengths - 256 * (parts - 1)
+
+    runs = np.empty(2 * len(run_length), dtype=np.uint8)
+    runs[0::2] = run_length - 1
+    runs[1::2] = run_index
+    payload = bytes([len(colors) - 1]) + colors.astype("<u2").tobytes() + runs.tobytes()
+    return payload, len(run_length)
+
+
+def classify(colors, edges, history):
+    """Content class from colour count, edge density and change history."""
+    if colors <= 16:
+        return "flat"
+    if colors <= 256 and edges > 0.08 and history < 0.5:
+        return "text"
+    return "photo"
+
+
+class TileEncoder:
+    def __init__(self, width, height, quality, link_kbps=4000, tile=TILE_SIZE, model=None):
+        self.width = width
+        self.height = height
+        self.quality = quality
+        self.tile = tile
+        self.model = model or DecodeModel()
+        self.bytes_per_us = link_kbps * 1000 / 8 / 1e6
+
+        self.rects = [(x, y, min(tile, width - x), min(tile, height - y))
+                      for y in range(0, height, tile) for x in range(0, width, tile)]
+        self.history = np.zeros(len(self.rects))
+        self.prev = None
+        self.dirty = set()
+
+        self.mix = Counter()
+        self.classes = Counter()
+        self.predicted_us = 0.0
+
+    def invalidate(self):
+        """Resend every tile on the next frame (receiver lost a frame)."""
+        self.prev = None
+
+    def mark_dirty(self, tiles):
+        """Tiles of a frame that was dropped before transmission."""
+        if tiles:
+            self.dirty.update(tiles)
+
+    def _cost(self, nbytes, decode_us):
+        return nbytes + decode_us * self.bytes_per_us
+
+    def _encode_tile(self, rgb, t565, luma, history):
+        pixels = t565.size
+        palette, runs = encode_palette(t565)
+        colors = 257 if palette is None else palette[0] + 1
+        edges = float(np.mean(np.abs(np.diff(luma, axis=1)) > 32)) if luma.shape[1] > 1 else 0.0
+        kind = classify(colors, edges, history)
+        self.classes[kind] += 1
+
+        candidates = []
+        if palette is not None:
+            candidates.append((proto.TILE_CODEC_PALETTE, palette,
+                               self.model.tile_us(proto.TILE_CODEC_PALETTE, pixels, len(palette), runs)))
+        if kind == "text":
+            raw = t565.astype("<u2").tobytes()
+            candidates.append((proto.TILE_CODEC_RAW565, raw,
+                               self.model.tile_us(proto.TILE_CODEC_RAW565, pixels, len(raw))))
+        if kind == "photo" or history >= 0.5:
+            jpeg = encode_jpeg(np.ascontiguousarray(rgb), self.quality)
+            candidates.append((proto.TILE_CODEC_JPEG, jpeg,
+                               self.model.tile_us(proto.TILE_CODEC_JPEG, pixels, len(jpeg))))
+        return min(candidates, key=lambda c: self._cost(len(c[1]), c[2]))
+
+    def encode(self, rgb):
+        """Returns (payload, tiled, tile indices sent, predicted decode us)."""
+        frame565 = rgb565(rgb)
+        luma = rgb.mean(axis=2)
+
+        records = []
+        sent = set()
+        tiles_us = 0.0
+        for i, (x, y, w, h) in enumerate(self.rects):
+            t565 = frame565[y:y + h, x:x + w]
+            changed = self.prev is None or i in self.dirty or \
+                not np.array_equal(t565, self.prev[y:y + h, x:x + w])
+            self.history[i] = 0.8 * self.history[i] + (0.2 if changed else 0.0)
+            if not changed:
+                continue
+            codec, payload, decode_us = self._encode_tile(
+                rgb[y:y + h, x:x + w], t565, luma[y:y + h, x:x + w], self.history[i])
+            records.append((codec, x, y, w, h, payload))
+            sent.add(i)
+            tiles_us += decode_us
+        self.dirty.clear()
+
+        tiled_bytes = 2 + sum(proto.TILE_HEADER.size + len(r[5]) for r in records)
+        full = encode_jpeg(rgb, self.quality)
+        full_us = self.model.frame_us(rgb.shape[0] * rgb.shape[1], len(full))
+        self.prev = frame565
+
+        if self._cost(len(full), full_us) < self._cost(tiled_bytes, tiles_us):
+            self.mix["full"] += 1
+            self.predicted_us += full_us
+            return full, False, set(range(len(self.rects))), full_us
+
+        out = bytearray(struct.pack("<H", len(records)))
+        for codec, x, y, w, h, payload in records:
+            out += proto.TILE_HEADER.pack(codec, x, y, w, h, len(payload))
+            out += payload
+            self.mix[CODEC_NAMES[codec]] += 1
+        self.mix["skip"] += len(self.rects) - len(records)
+        self.predicted_us += tiles_us
+        return bytes(out), True, sent, tiles_us
+
+    def take_report(self):
+        mix, self.mix = self.mix, Counter()
+        predicted, self.predicted_us = self.predicted_us, 0.0
+        return mix, predicted
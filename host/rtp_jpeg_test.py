@@ -0,0 +1,173 @@
+#!/usr/bin/env python3
+"""
+RTP/JPEG (RFC 2435) test sender for the Lilka RTP receiver.
+
+Encodes labelled test frames with Pillow and packetizes them by hand, so
+each case the receiver has to handle can be sent on its own:
+
+  q50       - Q 1-127: the device derives the tables from Q, 4:2:0 (type 1)
+  q50-422   - the same with 4:2:2 (type 0)
+  q255      - Q 255: tables inline in the first fragment of every frame
+  q200      - Q 128-254: tables sent once, then cached on the device
+  dri       - restart markers: types 64/65 with a restart marker header
+  fragments - 200-byte packets, so every frame spans dozens of them
+  loss      - 500-byte packets, one dropped every third frame; the device drops
+              those frames whole and counts them as lost
+
+Every case should show clean frames with its name and a moving bar; the
+serial log shows Q and the number of lost frames. Needs python3-pil.
+
+Usage: ./rtp_jpeg_test.py <IP> [--port 5004] [--fps 10] [--seconds 3] [CASE ...]
+"""
+import argparse
+import io
+import socket
+import struct
+import time
+
+from PIL import Image, ImageDraw
+
+WIDTH, HEIGHT = 280, 240
+RTP_PT_JPEG = 26
+RTP_CLOCK = 90000
+RTP_HEADER_SIZE = 12
+MTU = 1400  # Whole RTP packet, like rtpjpegpay
+
+# name: (quality, Q sent in the JPEG header, Pillow subsampling, restart interval in MCUs, packet size)
+CASES = {
+    "q50": (50, 50, 2, 0, MTU),
+    "q50-422": (50, 50, 1, 0, MTU),
+    "q255": (70, 255, 2, 0, MTU),
+    "q200": (40, 200, 2, 0, MTU),
+    "dri": (50, 50, 2, 35, MTU),
+    "fragments": (50, 50, 2, 0, 200),
+    "loss": (50, 50, 2, 0, 500),
+}
+
+
+def draw_frame(name, n):
+    image = Image.new("RGB", (WIDTH, HEIGHT))
+    draw = ImageDraw.Draw(image)
+    for x in range(0, WIDTH, 4):
+        draw.rectangle((x, 0, x + 3, HEIGHT), fill=(x * 255 // WIDTH, 80, 255 - x * 255 // WIDTH))
+    x = n * 8 % (WIDTH - 24)
+    draw.rectangle((x, 150, x + 24, 200), fill=(255, 255, 255))
+    draw.text((10, 20), f"RTP/JPEG {name}", fill=(255, 255, 255))
+    draw.text((10, 40), f"frame {n}", fill=(255, 255, 0))
+    return image
+
+
+def encode(image, quality, subsampling, restart_mcus):
+    out = io.BytesIO()
+    options = {"quality": quality, "subsampling": subsampling}
+    if restart_mcus:
+        options["restart_marker_blocks"] = restart_mcus
+    image.save(out, "JPEG", **options)
+    return out.getvalue()
+
+
+def parse_jpeg(jpg):
+    """Split a baseline JPEG into what RFC 2435 carries: 8-bit tables in
+    zigzag order (luma, chroma), size, type, restart interval and the scan"""
+    tables = {}
+    width = height = 0
+    jpeg_type = None
+    restart = 0
+    pos = 2
+    while pos < len(jpg):
+        marker = jpg[pos + 1]
+        length = struct.unpack(">H", jpg[pos + 2:pos + 4])[0]
+        segment = jpg[pos + 4:pos + 2 + length]
+        if marker == 0xDB:
+            i = 0
+            while i < len(segment):
+                if segment[i] >> 4:
+                    raise ValueError("16-bit quantization table")
+                tables[segment[i] & 0x0F] = segment[i + 1:i + 65]
+                i += 65
+        elif marker == 0xC0:
+            height, width = struct.unpack(">HH", segment[1:5])
+            sampling = segment[7]
+            jpeg_type = {0x22: 1, 0x21: 0}.get(sampling)
+            if jpeg_type is None:
+                raise ValueError(f"luma sampling {sampling:#x} has no RTP/JPEG type")
+        elif marker == 0xDD:
+            restart = struct.unpack(">H", segment[:2])[0]
+        elif marker == 0xDA:
+            scan = jpg[pos + 2 + length:]
+            if scan.endswith(b"\xff\xd9"):
+                scan = scan[:-2]
+            return tables[0] + tables[1], width, height, jpeg_type, restart, scan
+        pos += 2 + length
+    raise ValueError("no scan in JPEG")
+
+
+def packetize(jpg, q, send_tables, mtu, seq, timestamp, ssrc=0x4C494C4B):
+    tables, width, height, jpeg_type, restart, scan = parse_jpeg(jpg)
+    if restart:
+        jpeg_type += 64
+    packets = []
+    offset = 0
+    while offset < len(scan):
+        header = struct.pack(">B", 0) + offset.to_bytes(3, "big")
+        header += bytes((jpeg_type, q, width // 8, height // 8))
+        if restart:
+            # Fragments are not aligned to restart intervals: F = L = 1, count 0x3FFF
+            header += struct.pack(">HH", restart, 0xFFFF)
+        if offset == 0 and q >= 128:
+            if send_tables:
+                header += struct.pack(">BBH", 0, 0, len(tables)) + tables
+            else:
+                header += struct.pack(">BBH", 0, 0, 0)
+        chunk = scan[offset:offset + mtu - RTP_HEADER_SIZE - len(header)]
+        last = offset + len(chunk) >= len(scan)
+        rtp = struct.pack(">BBHII", 0x80, (0x80 if last else 0) | RTP_PT_JPEG, seq & 0xFFFF, timestamp, ssrc)
+        packets.append(rtp + header + chunk)
+        offset += len(chunk)
+        seq += 1
+    return packets, seq
+
+
+def run_case(sock, target, name, fps, seconds, seq):
+    quality, q, subsampling, restart_mcus, mtu = CASES[name]
+    frames = int(fps * seconds)
+    sent = lost = 0
+    start = time.monotonic()
+    for n in range(frames):
+        jpg = encode(draw_frame(name, n), quality, subsampling, restart_mcus)
+        # Q 128-254 tables are fixed per Q, so only the first frame carries them
+        send_tables = q == 255 or n == 0
+        timestamp = int(time.monotonic() * RTP_CLOCK) & 0xFFFFFFFF
+        packets, seq = packetize(jpg, q, send_tables, mtu, seq, timestamp)
+        if name == "loss" and n % 3 == 2 and len(packets) > 2:
+            del packets[1]
+            lost += 1
+        for packet in packets:
+            sock.sendto(packet, target)
+            sent += len(packet)
+        time.sleep(max(0.0, start + (n + 1) / fps - time.monotonic()))
+    print(f"{name}: {frames} frames, {len(packets)} packets/frame, {sent // 1024} KB, {lost} frames with a lost fragment")
+    return seq
+
+
+def main():
+    parser = argparse.ArgumentParser(description="RTP/JPEG (RFC 2435) test sender for Lilka")
+    parser.add_argument("host", help="Lilka IP")
+    parser.add_argument("cases", nargs="*", metavar="CASE",
+                        help=f"Cases to send, in order (default: all of {', '.join(CASES)})")
+    parser.add_argument("--port", type=int, default=5004, help="UDP port (default: 5004)")
+    parser.add_argument("--fps", type=int, default=10, help="Frames per second (default: 10)")
+    parser.add_argument("--seconds", type=float, default=3, help="Duration of each case (default: 3)")
+    args = parser.parse_args()
+    unknown = [name for name in args.cases if name not in CASES]
+    if unknown:
+        parser.error(f"unknown case {unknown[0]} (choose from {', '.join(CASES)})")
+
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    seq = 0
+    for name in args.cases or CASES:
+        seq = run_case(sock, (args.host, args.port), name, args.fps, args.seconds, seq)
+
+
+if __name__ == "__main__":
+    main()
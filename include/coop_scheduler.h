@@ -0,0 +1,41 @@
+#ifndef COOP_SCHEDULER_H
+#define COOP_SCHEDULER_H
+
+#include <Arduino.h>
+
+// Single-core chips have no second core for the network task.
+// There the pipeline stages run as cooperative steps on one task instead:
+// receive/scan is a state machine that handles one socket read per step,
+// and the decoder yields to it once per MCU row from the output callback,
+// so the socket keeps draining (and the TCP window stays open) while a
+// frame decodes. Define STREAM_COOPERATIVE=1 to use this on dual-core
+// chips too. test/test_coop_scheduler checks these properties on the host.
+#ifndef STREAM_COOPERATIVE
+#if CONFIG_FREERTOS_UNICORE
+#define STREAM_COOPERATIVE 1
+#else
+#define STREAM_COOPERATIVE 0
+#endif
+#endif
+
+#define COOP_MAX_TASKS 4
+
+// Minimum time between yields that actually run other steps
+#define COOP_MIN_SLICE_US 500
+
+// One bounded unit of work; returns true if it made progress
+typedef bool (*CoopStep)();
+
+bool coopAdd(const char* name, CoopStep step);
+
+// Run every step once, in order; returns true if any made progress
+bool coopRunOnce();
+
+// Called from inside a long step (e.g. the decode callback): runs the
+// other steps if the slice has elapsed. A step never re-enters itself.
+void coopYield();
+
+// Longest time a step waited between runs since the last call (us)
+uint32_t coopTakeMaxGap(const char* name);
+
+#endif // COOP_SCHEDULER_H
@@ -0,0 +1,21 @@
+#ifndef DISPLAY_CALIBRATION_H
+#define DISPLAY_CALIBRATION_H
+
+#include <Arduino.h>
+
+// NVS namespace for this app's own settings (Keira's WiFi lives in "kwifi")
+#define SETTINGS_NAMESPACE "mjpeg"
+
+// The ST7789 link bounds the achievable frame rate and its safe clock
+// varies between units. Calibration (hold A while the app starts) times
+// pushes of single MCU blocks, MCU-row strips and whole frames from SRAM
+// and PSRAM at each candidate SPI clock, shows a test pattern at each clock
+// for the user to confirm, and stores the fastest clean clock and output
+// mode in NVS together with the frame rate ceilings it measured.
+void runDisplayCalibration();
+
+// Switch the display bus to the stored clock and apply the stored output
+// mode; false if none
+bool applyDisplaySettings();
+
+#endif // DISPLAY_CALIBRATION_H
@@ -0,0 +1,35 @@
+#ifndef FRAME_HISTORY_H
+#define FRAME_HISTORY_H
+
+#include <Arduino.h>
+
+// Recent frames kept for pause and replay. Every JPEG frame shown live is
+// copied into a byte ring in PSRAM, indexed by a small table of offsets and
+// timestamps; the oldest frames are evicted by age, index size or when the
+// ring wraps over them. Tiled frames only update part of the screen, so
+// they are not recorded. While the viewer is paused or replaying, live
+// frames are still received and released, just not shown or recorded.
+#define HISTORY_SECONDS 10
+#define HISTORY_BYTES (2 * 1024 * 1024)
+#define HISTORY_FRAMES 512
+
+struct HistoryFrame {
+  const uint8_t* data;
+  size_t size;
+};
+
+bool beginFrameHistory();  // False without PSRAM; history stays off
+void recordHistoryFrame(const uint8_t* data, size_t size);
+
+// Viewer. While it is active the decode loop shows history, not live frames.
+bool historyActive();
+bool historyPause();  // Freeze on the newest frame
+bool historyStep(int delta, HistoryFrame* frame);
+bool historyReplay();  // From the paused frame, or the oldest; ends paused
+bool historyNextReplayFrame(HistoryFrame* frame);  // When the next one is due
+void historyResume();
+
+// Span, size and bytes per second of history for each JPEG quality seen
+void printHistoryStats();
+
+#endif // FRAME_HISTORY_H
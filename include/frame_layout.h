@@ -0,0 +1,55 @@
+#ifndef FRAME_LAYOUT_H
+#define FRAME_LAYOUT_H
+
+#include <Arduino.h>
+
+// Display dimensions
+#define DISPLAY_WIDTH  280
+#define DISPLAY_HEIGHT 240
+
+// Largest integer upscale (e.g. 140x120 frames are drawn at 2x)
+#define LAYOUT_MAX_SCALE 2
+
+// Largest picture-in-picture inset, in display pixels
+#define INSET_MAX_WIDTH  96
+#define INSET_MAX_HEIGHT 72
+
+// Where decoded frames land on the display. Every JPEG carries its own size,
+// so the sender can switch resolution on any frame boundary: smaller frames
+// are upscaled by an integer factor and centred, and only the letterbox bars
+// that the new layout no longer covers are cleared.
+bool jpegFrameSize(const uint8_t* data, size_t len, uint16_t* w, uint16_t* h);
+
+// Returns true when a frame drawn with a different layout is replaced
+bool setFrameLayout(uint16_t w, uint16_t h);
+void resetFrameLayout();
+
+// TJpgDec output: draws a decoded block with the current scale and offset.
+// Parts of the block under the inset are not pushed to the display.
+bool drawFrameBlock(int16_t x, int16_t y, uint16_t w, uint16_t h, uint16_t* bitmap);
+
+// Same for a block already in display coordinates (palette and raw tiles)
+void drawDisplayBlock(int16_t x, int16_t y, uint16_t* pixels, uint16_t w, uint16_t h);
+
+// Blocks are batched into one push per contiguous run (normally a full MCU
+// row); call after each frame to push the last run. Batching can be turned
+// off to compare against one push per block.
+void flushFrameBlocks();
+void setFrameBatching(bool enabled);
+bool frameBatchingEnabled();
+
+// Display pushes (address window + RAM write each) and time spent in them
+// since the last call
+void takeDisplayPushStats(uint32_t* pushes, uint32_t* us);
+
+// Picture-in-picture inset in the bottom-right corner, decoded by TJpgDec at
+// 1/2 or 1/4 scale. Returns that scale, or 0 if the frame is too large even
+// at 1/4; a 0x0 frame removes the inset. *changed is set when the corner
+// the inset used to cover needs the primary stream redrawn.
+uint8_t setInsetLayout(uint16_t w, uint16_t h, bool* changed);
+void insetOrigin(int16_t* x, int16_t* y);
+
+// While set, drawFrameBlock() draws into the inset instead
+void setInsetDrawing(bool drawing);
+
+#endif // FRAME_LAYOUT_H
@@ -0,0 +1,35 @@
+#ifndef FRAME_PREFETCH_H
+#define FRAME_PREFETCH_H
+
+#include <Arduino.h>
+#include "frame_queue.h"
+
+// Internal SRAM staging buffer size; larger frames are decoded from PSRAM
+#define PREFETCH_BUFFER_SIZE (32 * 1024)
+
+// A frame ready for decoding, either staged in internal SRAM or still in
+// its PSRAM slot. While it decodes, the oldest queued frame is copied into
+// the other staging buffer by the async memcpy (GDMA) engine. That frame
+// stays in the ready queue until it is taken, so a receiver that runs out
+// of slots still recycles it first and the copy is then discarded; with
+// prefetch off (button C) or without staging buffers nothing is copied
+// ahead.
+struct StagedFrame {
+  const uint8_t* data;
+  size_t size;
+  uint32_t seq;
+  bool tiled;
+  unsigned long readyUs;
+  bool inSram;
+  FrameSlot* slot;          // Still held if the frame was not staged
+};
+
+bool beginFramePrefetch();
+void setFramePrefetch(bool enabled);
+bool framePrefetchEnabled();
+
+bool nextStagedFrame(StagedFrame* frame, TickType_t timeout);
+void finishStagedFrame(StagedFrame* frame);
+void dropStagedFrames();
+
+#endif // FRAME_PREFETCH_H
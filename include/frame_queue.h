@@ -0,0 +1,70 @@
+#ifndef FRAME_QUEUE_H
+#define FRAME_QUEUE_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+
+// Number of PSRAM frame slots: one being received, one being decoded and
+// two ready, the oldest of which is being prefetched into SRAM. When the
+// decoder falls behind, the oldest ready frame is recycled so the screen
+// always shows the newest content.
+#define FRAME_SLOTS 4
+
+// Slot alignment, so the GDMA engine can copy slots out of PSRAM
+#define FRAME_SLOT_ALIGN 64
+
+struct FrameSlot {
+  uint8_t* data;
+  size_t size;
+  uint32_t seq;             // Frame sequence number since connect
+  bool tiled;               // Tile container instead of a single JPEG
+  unsigned long readyUs;    // micros() when the frame was complete
+  volatile uint8_t holders; // Receiver/decoder plus relays still sending it
+  volatile uint32_t generation;  // Bumped each time the receiver reuses the slot
+};
+
+// A set of frame slots with a free and a ready queue, filled by one
+// receiver and drained by the decode loop. When the decoder falls behind,
+// acquiring a slot recycles the oldest ready frame.
+struct FramePool {
+  FrameSlot* slots;
+  int count;
+  size_t capacity;
+  QueueHandle_t freeQueue;
+  QueueHandle_t readyQueue;
+  volatile uint32_t dropped;
+};
+
+// Slots come from PSRAM; with internalFallback they may come from internal
+// RAM instead
+bool allocateFramePool(FramePool* pool, FrameSlot* slots, int count, size_t slotSize,
+                       bool internalFallback);
+FrameSlot* acquirePoolSlot(FramePool* pool);
+void submitPoolSlot(FramePool* pool, FrameSlot* slot);
+FrameSlot* takePoolSlot(FramePool* pool, TickType_t timeout);
+void releasePoolSlot(FramePool* pool, FrameSlot* slot);
+void flushFramePool(FramePool* pool);
+
+// Primary frame slot queue shared by the network task (producer) and the
+// decode loop (consumer)
+bool allocateFrameQueue(size_t slotSize);
+size_t frameSlotCapacity();
+FramePool* frameQueuePool();  // For helpers shared with the inset stream
+
+FrameSlot* acquireFrameSlot();
+void submitFrameSlot(FrameSlot* slot);
+FrameSlot* waitFrameSlot(TickType_t timeout);
+// Oldest ready frame, left in the queue so the receiver can still recycle
+// it; its generation changes if it does
+FrameSlot* peekFrameSlot(uint32_t* generation);
+// A relay keeps a submitted frame until it has been forwarded; the slot
+// returns to the free list when the last holder releases it
+void holdFrameSlot(FrameSlot* slot);
+void releaseFrameSlot(FrameSlot* slot);
+void flushFrameQueue();
+
+uint32_t frameQueueDepth();
+uint32_t framesDropped();
+
+#endif // FRAME_QUEUE_H
@@ -0,0 +1,31 @@
+#ifndef FRAME_RELAY_H
+#define FRAME_RELAY_H
+
+#include <Arduino.h>
+#include "frame_queue.h"
+
+#define RELAY_MAX_DOWNSTREAM 2
+#define RELAY_MAX_NODES      10  // Relay list that fits in one control message
+
+// Daisy-chain relay. The sender gives the first receiver a CTRL_RELAY list
+// of downstream receivers: node 0 is that receiver, list entry k is node
+// k + 1, and node i forwards to nodes i * fanout + 1 ... i * fanout + fanout
+// (fan-out 1 is a chain, 2 a binary tree). Each node passes the list on to
+// its own downstreams, so one host connection configures the whole tree.
+//
+// Every received frame is forwarded straight from its frame slot while the
+// decoder works on it: each downstream has a task on core 0 that writes the
+// frame as mux video packets and holds the slot until it is sent. A
+// downstream that is still sending when the next frame arrives gets the
+// newer frame instead of the waiting one, so a slow hop only loses frames
+// for itself and the nodes behind it. Tiled frames it loses are recovered
+// by a refresh from the sender, which the relay requests at most once a
+// second for all hops together.
+//
+// scripts/relay_chain.sh runs a chain or tree of host-built receivers
+// (env:native_relay, sources in native/) on localhost.
+void relayConfigure(const uint8_t* msg, size_t len);  // CTRL_RELAY payload
+void relayFrame(FrameSlot* slot);                      // Called for each received frame
+void printRelayStats();
+
+#endif // FRAME_RELAY_H
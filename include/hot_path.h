@@ -0,0 +1,23 @@
+#ifndef HOT_PATH_H
+#define HOT_PATH_H
+
+#include <Arduino.h>
+
+// Code that runs per pixel, per MCU or per received byte normally executes
+// from flash through the instruction cache, where it competes with the WiFi
+// stack for cache lines and decode times jitter. Building with
+// STREAM_HOT_IRAM=1 (env:lilka_v2_iram) places these functions in IRAM;
+// scripts/hot_iram.py does the same for TJpgDec's Huffman decoder, IDCT,
+// colour conversion and their tables. Compare the decode percentiles in the
+// serial stats (or the exported histogram) between the two builds.
+#ifndef STREAM_HOT_IRAM
+#define STREAM_HOT_IRAM 0
+#endif
+
+#if STREAM_HOT_IRAM
+#define HOT_IRAM IRAM_ATTR
+#else
+#define HOT_IRAM
+#endif
+
+#endif // HOT_PATH_H
@@ -0,0 +1,23 @@
+#ifndef INSET_STREAM_H
+#define INSET_STREAM_H
+
+#include <Arduino.h>
+#include "frame_queue.h"
+
+#define INSET_PORT 8091
+
+// Secondary raw MJPEG stream (e.g. a camera) shown as a picture-in-picture
+// inset over the primary stream. It has its own listener, receive task and
+// small set of PSRAM slots; the decode loop takes the newest complete frame
+// and drops older ones, so a slow inset never delays the primary stream.
+bool beginInsetStream();  // False without PSRAM; the inset stays off
+bool pollInsetStream();   // Cooperative builds: one receive step
+bool insetConnected();
+
+FrameSlot* takeInsetFrame();  // Newest complete frame, or nullptr
+void releaseInsetFrame(FrameSlot* slot);
+
+uint32_t insetBytesReceived();
+uint32_t insetFramesDropped();
+
+#endif // INSET_STREAM_H
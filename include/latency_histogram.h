@@ -0,0 +1,20 @@
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <Arduino.h>
+
+// Log-linear histogram of microsecond latencies: four sub-buckets per power
+// of two (about 19% wide), covering 0 us to 2^25 us (~33 s) in 96 buckets.
+// The last bucket starts at ~29 s and also takes anything longer.
+#define LATENCY_BUCKETS 96
+
+struct LatencyHistogram {
+  uint16_t counts[LATENCY_BUCKETS];
+  uint32_t total;
+};
+
+void latencyReset(LatencyHistogram* hist);
+void latencyRecord(LatencyHistogram* hist, uint32_t us);
+uint32_t latencyPercentile(const LatencyHistogram* hist, uint8_t percent);
+
+#endif // LATENCY_HISTOGRAM_H
@@ -0,0 +1,26 @@
+#ifndef MJPEG_SCANNER_H
+#define MJPEG_SCANNER_H
+
+#include <Arduino.h>
+#include "frame_queue.h"
+
+// Splits a raw MJPEG byte stream into frames at the SOI (0xFFD8) and EOI
+// (0xFFD9) markers, for the primary raw stream and the inset stream alike.
+// Bytes are read straight into a slot from the pool; once it holds a whole
+// frame, the bytes after it move to a fresh slot and the frame goes to the
+// sink, which owns it from then on.
+typedef void (*MjpegFrameSink)(FrameSlot* frame);
+
+struct MjpegScanner {
+  FramePool* pool;
+  MjpegFrameSink sink;
+  size_t scanPos;  // Bytes of the current slot already searched for EOI
+};
+
+void mjpegScanReset(MjpegScanner* scanner);
+// Hands every complete frame in slot to the sink and returns the slot to
+// keep receiving into. Bytes before an SOI are discarded, and so is a frame
+// that gets within 1 KB of the slot capacity without an EOI.
+FrameSlot* mjpegScan(MjpegScanner* scanner, FrameSlot* slot);
+
+#endif // MJPEG_SCANNER_H
@@ -0,0 +1,39 @@
+#ifndef OSD_H
+#define OSD_H
+
+#include <Arduino.h>
+
+// On-screen stats overlay. The text is rendered once per update into a 1-bit
+// mask, and the output stage blends it into every pixel block it is about to
+// push (see drawFrameBlock), so a frame with the overlay costs the same
+// number of display transfers as one without. The pixels under the overlay
+// are kept, so regions a frame does not repaint (unchanged tiles, letterbox
+// bars) are redrawn from that copy when the text changes.
+#define OSD_X 4
+#define OSD_Y 4
+#define OSD_COLS 16
+#define OSD_ROWS 3
+
+struct OsdStats {
+  uint16_t fpsX10;
+  uint32_t decodeUs;       // Median over the last interval
+  uint16_t kbps;
+  uint32_t framesDropped;  // In the last interval
+  int8_t rssi;
+  uint8_t queueDepth;
+};
+
+void osdSetEnabled(bool enabled);
+bool osdEnabled();
+void osdUpdate(const OsdStats* stats);
+
+// Blend the overlay into a block in display coordinates (stride = w)
+void osdComposite(int16_t x, int16_t y, uint16_t w, uint16_t h, uint16_t* bitmap);
+
+// After a frame: redraw the overlay area if the frame did not cover it
+void osdFinishFrame();
+
+// The display under the overlay was cleared (new layout, waiting screen)
+void osdBackgroundCleared();
+
+#endif // OSD_H
@@ -0,0 +1,23 @@
+#ifndef RTP_RECEIVER_H
+#define RTP_RECEIVER_H
+
+#include <Arduino.h>
+
+#define RTP_PORT 5004
+
+// RTP/JPEG (RFC 2435) over UDP, as sent by GStreamer's rtpjpegpay. The
+// payload carries only the entropy-coded scan plus type, Q and size; the
+// JFIF headers are rebuilt from quantisation tables cached per Q value and
+// the standard Huffman tables. Fragments are reassembled by timestamp and
+// offset straight into the primary frame queue; a frame with a missing
+// fragment is dropped as a whole. The stream counts as connected while
+// packets keep arriving.
+bool beginRtpReceiver();
+bool pollRtpReceiver();  // Cooperative builds: one receive step
+bool rtpActive();
+
+uint32_t rtpBytesReceived();   // Cumulative, wraps around
+uint32_t rtpFramesLost();      // Cumulative, incomplete or unsupported frames
+uint8_t rtpQuality();          // Q of the last frame
+
+#endif // RTP_RECEIVER_H
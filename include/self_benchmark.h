@@ -0,0 +1,23 @@
+#ifndef SELF_BENCHMARK_H
+#define SELF_BENCHMARK_H
+
+#include <Arduino.h>
+#include <TJpg_Decoder.h>
+
+// Streamed content varies too much to compare units or builds, so the
+// firmware embeds a fixed JPEG corpus (assets/bench, generated by
+// scripts/make_bench_corpus.py): text, photo and UI at qualities 30/50/80
+// plus a half-size frame. Hold B while the app starts, or press B on the
+// waiting screen, to decode every image through each pipeline mode:
+//   decode        - decode only, JPEG in internal SRAM
+//   decode_psram  - decode only, JPEG in PSRAM (the unprefetched path)
+//   decode_half   - decode only at 1/2 scale (the inset path)
+//   strips        - decode and push in MCU-row strips, push time separately
+//   blocks        - decode and push one 16x16 block at a time
+// The serial log gets a per-image table and one "Fingerprint:" line with
+// the corpus averages (us per frame, compressed MB/s, Mpixel/s), tagged
+// with chip, clocks, hot path placement and a corpus checksum.
+// `output` is the stream's TJpgDec callback, restored afterwards.
+void runSelfBenchmark(SketchCallback output);
+
+#endif // SELF_BENCHMARK_H
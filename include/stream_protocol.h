@@ -0,0 +1,94 @@
+#ifndef STREAM_PROTOCOL_H
+#define STREAM_PROTOCOL_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Multiplexed stream protocol (mirrored in host/lilkastream/protocol.py)
+//
+// A connection that starts with MUX_MAGIC carries framed packets:
+//   [channel:u8][flags:u8][length:u16 LE][payload...]
+// Any other connection is treated as a raw MJPEG byte stream, so plain
+// GStreamer tcpclientsink senders keep working.
+//
+// Frame size is not part of the protocol: the receiver reads it from each
+// JPEG, so the sender may change resolution on any frame boundary.
+//
+// The sender always transmits the highest-priority (lowest-numbered)
+// channel first and splits video frames into MUX_VIDEO_CHUNK sized packets,
+// so a small control or cursor packet never waits behind a whole JPEG.
+#define MUX_MAGIC       "LMX1"
+#define MUX_MAGIC_LEN   4
+#define MUX_HEADER_SIZE 4
+#define MUX_VIDEO_CHUNK 1024
+#define MUX_MAX_MESSAGE 64  // Largest non-video payload
+
+enum MuxChannel : uint8_t {
+  MUX_CH_CONTROL   = 0,  // Ping/pong and settings (both directions)
+  MUX_CH_CURSOR    = 1,  // Pointer position (host -> device)
+  MUX_CH_INPUT     = 2,  // Button events (device -> host)
+  MUX_CH_TELEMETRY = 3,  // Frame acks and stats (device -> host)
+  MUX_CH_VIDEO     = 4,  // JPEG frame chunks (host -> device)
+};
+
+// Video packet flags
+#define MUX_FLAG_FRAME_START 0x01
+#define MUX_FLAG_FRAME_END   0x02
+#define MUX_FLAG_TILED       0x04  // On FRAME_START: payload is a tile container
+#define MUX_FLAG_PROBE       0x08  // On FRAME_START: padding for bandwidth probing,
+                                   // discarded and answered with TELEM_PROBE
+
+// Tile container (MUX_FLAG_TILED frames):
+//   [tile count:u16]
+//   per tile: [codec:u8][x:u16][y:u16][w:u16][h:u16][length:u32][payload...]
+// Tiles not listed are unchanged since the previous frame.
+#define TILE_HEADER_SIZE 13
+#define TILE_MAX_PIXELS  (64 * 64)
+
+enum TileCodec : uint8_t {
+  TILE_CODEC_JPEG    = 0,  // Baseline JPEG of the tile
+  TILE_CODEC_PALETTE = 1,  // [n-1:u8][n x RGB565 LE][runs of (len-1:u8, index:u8)]
+  TILE_CODEC_RAW565  = 2,  // w*h RGB565 LE pixels
+  TILE_CODEC_COUNT
+};
+
+// Control messages (first payload byte is the message type)
+#define CTRL_PING 0x01  // u32 seq, u32 host timestamp (us)
+#define CTRL_PONG 0x02  // Echo of the PING payload
+#define CTRL_REFRESH 0x03  // Device lost a tiled frame; resend all tiles
+#define CTRL_RELAY 0x04    // u8 fan-out, u8 own index, u8 count, count x (IPv4[4], u16 port);
+                           // see frame_relay.h
+
+// Cursor messages
+#define CURSOR_POS 0x01  // i16 x, i16 y, u8 visible
+
+// Input messages
+#define INPUT_BUTTON 0x01  // u8 button index, u8 pressed
+
+// Telemetry messages
+#define TELEM_FRAME_ACK  0x01  // u32 frame seq, u32 size, u32 queue us, u32 decode us
+#define TELEM_TILE_STATS 0x02  // u32 frame seq, per codec: u16 tiles, u32 decode us
+#define TELEM_STATS      0x03  // Periodic device stats, see sendDeviceStats()
+#define TELEM_PROBE      0x04  // u32 frame seq, u32 bytes, u32 us from first to last chunk
+
+static inline void putLE16(uint8_t* p, uint16_t v) {
+  p[0] = v & 0xFF;
+  p[1] = v >> 8;
+}
+
+static inline void putLE32(uint8_t* p, uint32_t v) {
+  p[0] = v & 0xFF;
+  p[1] = (v >> 8) & 0xFF;
+  p[2] = (v >> 16) & 0xFF;
+  p[3] = v >> 24;
+}
+
+static inline uint16_t getLE16(const uint8_t* p) {
+  return p[0] | (p[1] << 8);
+}
+
+static inline uint32_t getLE32(const uint8_t* p) {
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+#endif // STREAM_PROTOCOL_H
@@ -0,0 +1,54 @@
+#ifndef STREAM_RECEIVER_H
+#define STREAM_RECEIVER_H
+
+#include <Arduino.h>
+#include <WiFiClient.h>
+#include <WiFiServer.h>
+#include "tile_decoder.h"
+
+#define STREAM_PORT 8090
+
+// Network side of the receiver. A dedicated task on core 0 accepts the
+// client, demultiplexes the stream and answers control messages right away,
+// while complete JPEG frames are handed to the decode loop through the
+// frame queue. Cooperative builds (see coop_scheduler.h) have no task and
+// call pollStreamReceiver() instead.
+bool beginStreamReceiver();
+bool pollStreamReceiver();  // One receive step; true if data was read
+bool streamConnected();
+bool streamIsMultiplexed();
+uint32_t streamBytesReceived();  // Cumulative, wraps around
+
+// Accept a waiting client, polling the listener at most every intervalMs
+// (shared with the inset stream)
+bool acceptStreamClient(WiFiServer& server, WiFiClient& client, unsigned long* lastAcceptMs,
+                        unsigned long intervalMs);
+
+// Periodic device stats for the sender's metrics exporter
+struct DeviceStats {
+  uint16_t fpsX10;
+  uint16_t kbps;
+  uint32_t decodeP50Us;
+  uint32_t decodeP90Us;
+  uint32_t decodeP99Us;
+  uint32_t framesDropped;   // Cumulative
+  int8_t rssi;
+  uint8_t queueDepth;
+  uint16_t reconnects;      // Connections accepted since boot
+  uint32_t framesDecoded;   // Cumulative
+  uint32_t uptimeS;
+};
+
+uint16_t streamConnectionCount();
+
+// Device -> host messages (dropped for raw MJPEG senders)
+void sendDeviceStats(const DeviceStats* stats);
+void sendFrameAck(uint32_t seq, uint32_t size, uint32_t queueUs, uint32_t decodeUs);
+void sendTileStats(uint32_t seq, const TileStats* stats);
+void requestRefresh();
+void sendInputEvent(uint8_t button, bool pressed);
+
+// Last pointer position received on the cursor channel
+bool streamCursor(int16_t* x, int16_t* y);
+
+#endif // STREAM_RECEIVER_H
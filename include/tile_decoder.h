@@ -0,0 +1,18 @@
+#ifndef TILE_DECODER_H
+#define TILE_DECODER_H
+
+#include <Arduino.h>
+#include <TJpg_Decoder.h>
+#include "stream_protocol.h"
+
+// Per-codec decode cost of one tiled frame, reported back to the sender
+struct TileStats {
+  uint16_t tiles[TILE_CODEC_COUNT];
+  uint32_t decodeUs[TILE_CODEC_COUNT];
+};
+
+// Decode a tile container, dispatching each tile to its codec.
+// JPEG tiles go through TJpgDec and the normal output callback.
+JRESULT decodeTileFrame(const uint8_t* data, size_t len, TileStats* stats);
+
+#endif // TILE_DECODER_H
@@ -2,6 +2,7 @@
 #define WIFI_CONFIG_H
 
 #include <Arduino.h>
+#include <IPAddress.h>
 
 // KeiraOS WiFi namespace - shared credentials storage
 #define WIFI_NAMESPACE "kwifi"
@@ -9,6 +10,45 @@
 // WiFi credential functions for Keira integration
 String hashSSID(String ssid);
 bool loadWiFiCredentials(String& ssid, String& password);
-bool connectToWiFi(String ssid, String password);
+bool connectToWiFi(String ssid, String password, const uint8_t* bssid = nullptr, int32_t channel = 0);
+
+#define WIFI_MAX_CHANNEL 13
+
+// Scan for every network saved in Keira and join the AP (BSSID) with the
+// best expected throughput: the HT20 rate its RSSI allows, shared with the
+// other APs on overlapping channels. Falls back to `ssid` (Keira's last
+// network) when none is in range, e.g. a hidden SSID.
+bool connectToBestWiFi(String ssid, String password);
+
+// Roaming: call once a second with the stream's receive rate. When it stays
+// under ROAM_DROP_PERCENT of its running baseline for ROAM_WINDOW_S seconds
+// on a weak link, a background scan looks for an AP expected to be
+// ROAM_MIN_GAIN times better and switches to it, logging the throughput
+// before and over the ROAM_WINDOW_S seconds after the switch. The join runs
+// in the background: pollWiFiRoaming(), called from every loop() pass even
+// while no stream is connected, completes it or falls back after
+// ROAM_JOIN_TIMEOUT_MS.
+#define ROAM_DROP_PERCENT 50
+#define ROAM_WINDOW_S 5
+#define ROAM_RSSI_DBM -67            // Links stronger than this are left alone
+#define ROAM_MIN_BASELINE_KBPS 200   // Ignore idle streams
+#define ROAM_MIN_GAIN 1.5f
+#define ROAM_COOLDOWN_MS 60000
+#define ROAM_JOIN_TIMEOUT_MS 8000
+void updateWiFiRoaming(uint32_t kbps);
+void pollWiFiRoaming();
+
+// Direct link: the Lilka runs its own access point and the sender joins it,
+// so frames cross the air once instead of twice through an office AP. The
+// SSID ("Lilka-XXXX") and a random password are generated on first use and
+// kept in NVS; the channel is the least congested of 1-11 in a quick scan.
+#define DIRECT_LINK_MAX_CHANNEL 11  // 12-13 are not allowed everywhere
+bool startDirectLink();
+bool directLinkActive();
+String directLinkSSID();
+String directLinkPassword();
+IPAddress linkIP();
+// RSSI of the AP, or of the first joined station in direct-link mode
+int8_t linkRSSI();
 
 #endif // WIFI_CONFIG_H
@@ -0,0 +1,46 @@
+#ifndef NATIVE_ARDUINO_H
+#define NATIVE_ARDUINO_H
+
+// Just enough of the Arduino core to build the receive path on the host
+// (env:native_relay, env:native). Implemented in native/posix.cpp; tests
+// provide their own clock instead.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <freertos/FreeRTOS.h>
+
+using std::max;
+using std::min;
+
+#define IRAM_ATTR
+#define DRAM_ATTR
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+
+class String {
+ public:
+  String(const char* s = "") : s(s) {}
+  const char* c_str() const { return s.c_str(); }
+  unsigned length() const { return s.size(); }
+
+ private:
+  std::string s;
+};
+
+class HardwareSerial {
+ public:
+  void begin(unsigned long baud) {}
+  size_t printf(const char* format, ...);
+  size_t println(const char* s = "");
+};
+
+extern HardwareSerial Serial;
+
+#endif // NATIVE_ARDUINO_H
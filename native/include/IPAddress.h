@@ -0,0 +1,21 @@
+#ifndef NATIVE_IPADDRESS_H
+#define NATIVE_IPADDRESS_H
+
+#include <Arduino.h>
+
+class IPAddress {
+ public:
+  IPAddress() {}
+  IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : bytes{a, b, c, d} {}
+  uint8_t operator[](int i) const { return bytes[i]; }
+  String toString() const {
+    char text[16];
+    snprintf(text, sizeof(text), "%u.%u.%u.%u", bytes[0], bytes[1], bytes[2], bytes[3]);
+    return String(text);
+  }
+
+ private:
+  uint8_t bytes[4] = {0, 0, 0, 0};
+};
+
+#endif // NATIVE_IPADDRESS_H
@@ -0,0 +1,17 @@
+#ifndef NATIVE_TJPG_DECODER_H
+#define NATIVE_TJPG_DECODER_H
+
+// Result codes only: the host build does not decode
+typedef enum {
+  JDR_OK = 0,
+  JDR_INTR,
+  JDR_INP,
+  JDR_MEM1,
+  JDR_MEM2,
+  JDR_PAR,
+  JDR_FMT1,
+  JDR_FMT2,
+  JDR_FMT3
+} JRESULT;
+
+#endif // NATIVE_TJPG_DECODER_H
@@ -0,0 +1,8 @@
+#ifndef NATIVE_WIFI_H
+#define NATIVE_WIFI_H
+
+#include <IPAddress.h>
+#include <WiFiClient.h>
+#include <WiFiServer.h>
+
+#endif // NATIVE_WIFI_H
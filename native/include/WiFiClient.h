@@ -0,0 +1,27 @@
+#ifndef NATIVE_WIFICLIENT_H
+#define NATIVE_WIFICLIENT_H
+
+#include <Arduino.h>
+#include <IPAddress.h>
+
+// TCP client over a plain POSIX socket
+class WiFiClient {
+ public:
+  WiFiClient() {}
+  explicit WiFiClient(int sock) : sock(sock) {}
+  operator bool() const { return sock >= 0; }
+  bool connected();
+  int available();
+  int read(uint8_t* buf, size_t size);
+  size_t write(const uint8_t* buf, size_t size);
+  int connect(IPAddress ip, uint16_t port, int32_t timeoutMs);
+  void setNoDelay(bool noDelay);
+  void setTimeout(uint32_t timeoutMs) {}
+  void stop();
+  int fd() const { return sock; }
+
+ private:
+  int sock = -1;
+};
+
+#endif // NATIVE_WIFICLIENT_H
@@ -0,0 +1,20 @@
+#ifndef NATIVE_WIFISERVER_H
+#define NATIVE_WIFISERVER_H
+
+#include <WiFiClient.h>
+
+// Listens on 127.0.0.1, on the port from the LISTEN_PORT environment
+// variable if set, so several nodes can run on one host
+class WiFiServer {
+ public:
+  explicit WiFiServer(uint16_t port) : port(port) {}
+  void begin();
+  void setNoDelay(bool noDelay) {}
+  WiFiClient available();  // Accepts without blocking
+
+ private:
+  uint16_t port;
+  int sock = -1;
+};
+
+#endif // NATIVE_WIFISERVER_H
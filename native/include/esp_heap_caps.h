@@ -0,0 +1,12 @@
+#ifndef NATIVE_ESP_HEAP_CAPS_H
+#define NATIVE_ESP_HEAP_CAPS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define MALLOC_CAP_INTERNAL (1 << 0)
+#define MALLOC_CAP_SPIRAM   (1 << 1)
+
+void* heap_caps_aligned_alloc(size_t alignment, size_t size, uint32_t caps);
+
+#endif // NATIVE_ESP_HEAP_CAPS_H
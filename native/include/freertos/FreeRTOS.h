@@ -0,0 +1,24 @@
+#ifndef NATIVE_FREERTOS_H
+#define NATIVE_FREERTOS_H
+
+// FreeRTOS queues, tasks and mutexes on std::thread (native/posix.cpp).
+// Ticks are milliseconds and task priorities and cores are ignored.
+
+#include <stdint.h>
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned UBaseType_t;
+typedef void* QueueHandle_t;
+typedef void* TaskHandle_t;
+typedef void* SemaphoreHandle_t;
+typedef void (*TaskFunction_t)(void*);
+
+#define pdFALSE 0
+#define pdTRUE 1
+#define pdPASS pdTRUE
+#define portMAX_DELAY ((TickType_t)0xffffffff)
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+
+#endif // NATIVE_FREERTOS_H
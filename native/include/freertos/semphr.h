@@ -0,0 +1,10 @@
+#ifndef NATIVE_FREERTOS_SEMPHR_H
+#define NATIVE_FREERTOS_SEMPHR_H
+
+#include <freertos/FreeRTOS.h>
+
+SemaphoreHandle_t xSemaphoreCreateMutex();
+BaseType_t xSemaphoreTake(SemaphoreHandle_t mutex, TickType_t wait);  // Always waits
+BaseType_t xSemaphoreGive(SemaphoreHandle_t mutex);
+
+#endif // NATIVE_FREERTOS_SEMPHR_H
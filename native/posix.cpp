@@ -0,0 +1,219 @@
+// Host implementations of the Arduino, FreeRTOS and WiFi calls used by the
+// receive path (native/include), on std::thread and POSIX sockets
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <esp_heap_caps.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#include <lwip/sockets.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/tcp.h>
+#include <stdarg.h>
+#include <sys/ioctl.h>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+HardwareSerial Serial;
+static std::mutex serialLock;  // Tasks print whole lines
+
+size_t HardwareSerial::printf(const char* format, ...) {
+  std::lock_guard<std::mutex> lock(serialLock);
+  va_list args;
+  va_start(args, format);
+  int n = vprintf(format, args);
+  va_end(args);
+  fflush(stdout);
+  return n < 0 ? 0 : n;
+}
+
+size_t HardwareSerial::println(const char* s) {
+  return printf("%s\n", s);
+}
+
+static const auto startTime = std::chrono::steady_clock::now();
+
+unsigned long micros() {
+  auto elapsed = std::chrono::steady_clock::now() - startTime;
+  return std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+}
+
+unsigned long millis() {
+  return micros() / 1000;
+}
+
+void delay(unsigned long ms) {
+  std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void* heap_caps_aligned_alloc(size_t alignment, size_t size, uint32_t caps) {
+  return aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+}
+
+struct Queue {
+  std::mutex lock;
+  std::condition_variable changed;
+  std::deque<std::vector<uint8_t>> items;
+  size_t length;
+  size_t itemSize;
+};
+
+// Waits until the queue has space (or an item), for at most wait ticks
+static bool waitQueue(std::unique_lock<std::mutex>& lock, Queue* q, TickType_t wait, bool forSpace) {
+  auto ready = [&] { return forSpace ? q->items.size() < q->length : !q->items.empty(); };
+  if (wait == portMAX_DELAY) {
+    q->changed.wait(lock, ready);
+    return true;
+  }
+  return q->changed.wait_for(lock, std::chrono::milliseconds(wait), ready);
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize) {
+  Queue* q = new Queue();
+  q->length = length;
+  q->itemSize = itemSize;
+  return q;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t wait) {
+  Queue* q = (Queue*)queue;
+  std::unique_lock<std::mutex> lock(q->lock);
+  if (!waitQueue(lock, q, wait, true)) return pdFALSE;
+  q->items.emplace_back((const uint8_t*)item, (const uint8_t*)item + q->itemSize);
+  q->changed.notify_all();
+  return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void* item, TickType_t wait) {
+  Queue* q = (Queue*)queue;
+  std::unique_lock<std::mutex> lock(q->lock);
+  if (!waitQueue(lock, q, wait, false)) return pdFALSE;
+  memcpy(item, q->items.front().data(), q->itemSize);
+  q->items.pop_front();
+  q->changed.notify_all();
+  return pdTRUE;
+}
+
+BaseType_t xQueuePeek(QueueHandle_t queue, void* item, TickType_t wait) {
+  Queue* q = (Queue*)queue;
+  std::unique_lock<std::mutex> lock(q->lock);
+  if (!waitQueue(lock, q, wait, false)) return pdFALSE;
+  memcpy(item, q->items.front().data(), q->itemSize);
+  return pdTRUE;
+}
+
+BaseType_t xQueueReset(QueueHandle_t queue) {
+  Queue* q = (Queue*)queue;
+  std::lock_guard<std::mutex> lock(q->lock);
+  q->items.clear();
+  q->changed.notify_all();
+  return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+  Queue* q = (Queue*)queue;
+  std::lock_guard<std::mutex> lock(q->lock);
+  return q->items.size();
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t task, const char* name, uint32_t stackSize, void* arg,
+                                   UBaseType_t priority, TaskHandle_t* handle, BaseType_t core) {
+  std::thread(task, arg).detach();
+  return pdPASS;
+}
+
+void vTaskDelay(TickType_t ticks) {
+  std::this_thread::sleep_for(std::chrono::milliseconds(ticks ? ticks : 1));
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex() {
+  return new std::recursive_mutex();
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t mutex, TickType_t wait) {
+  ((std::recursive_mutex*)mutex)->lock();
+  return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t mutex) {
+  ((std::recursive_mutex*)mutex)->unlock();
+  return pdTRUE;
+}
+
+bool WiFiClient::connected() {
+  if (sock < 0) return false;
+  char c;
+  ssize_t n = recv(sock, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+  return n > 0 || (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK));
+}
+
+int WiFiClient::available() {
+  int n = 0;
+  if (sock < 0 || ioctl(sock, FIONREAD, &n) < 0) return 0;
+  return n;
+}
+
+int WiFiClient::read(uint8_t* buf, size_t size) {
+  return recv(sock, buf, size, MSG_DONTWAIT);
+}
+
+size_t WiFiClient::write(const uint8_t* buf, size_t size) {
+  ssize_t n = send(sock, buf, size, MSG_NOSIGNAL);
+  return n < 0 ? 0 : n;
+}
+
+int WiFiClient::connect(IPAddress ip, uint16_t port, int32_t timeoutMs) {
+  stop();
+  sock = socket(AF_INET, SOCK_STREAM, 0);
+  if (sock < 0) return 0;
+  // A send buffer closer to lwIP's, so a slow downstream shows up as on the device
+  int sendBuffer = 8192;
+  setsockopt(sock, SOL_SOCKET, SO_SNDBUF, &sendBuffer, sizeof(sendBuffer));
+  sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl((ip[0] << 24) | (ip[1] << 16) | (ip[2] << 8) | ip[3]);
+  if (::connect(sock, (sockaddr*)&addr, sizeof(addr)) < 0) {
+    stop();
+    return 0;
+  }
+  return 1;
+}
+
+void WiFiClient::setNoDelay(bool noDelay) {
+  int value = noDelay;
+  setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &value, sizeof(value));
+}
+
+void WiFiClient::stop() {
+  if (sock >= 0) close(sock);
+  sock = -1;
+}
+
+void WiFiServer::begin() {
+  const char* listenPort = getenv("LISTEN_PORT");
+  if (listenPort) port = atoi(listenPort);
+  sock = socket(AF_INET, SOCK_STREAM, 0);
+  int reuse = 1;
+  setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+  sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (bind(sock, (sockaddr*)&addr, sizeof(addr)) < 0 || listen(sock, 1) < 0) {
+    perror("WiFiServer");
+    exit(1);
+  }
+  fcntl(sock, F_SETFL, O_NONBLOCK);
+}
+
+WiFiClient WiFiServer::available() {
+  return WiFiClient(accept(sock, nullptr, nullptr));
+}
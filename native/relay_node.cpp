@@ -0,0 +1,49 @@
+// Host-built receiver for relay tests (env:native_relay): receives and
+// relays like the device, then "decodes" each frame by hashing it and
+// sleeping DECODE_MS (default 10) before acking. scripts/relay_chain.sh
+// starts several on localhost, each on its own LISTEN_PORT.
+
+#include <Arduino.h>
+#include <signal.h>
+#include "frame_queue.h"
+#include "frame_relay.h"
+#include "stream_receiver.h"
+
+#define NODE_FRAME_SLOT_SIZE (100 * 1024)
+#define NODE_STATS_MS        2000
+
+int main() {
+  signal(SIGPIPE, SIG_IGN);  // A downstream that goes away fails the send instead
+  const char* decodeMsEnv = getenv("DECODE_MS");
+  unsigned long decodeMs = decodeMsEnv ? atoi(decodeMsEnv) : 10;
+  const char* port = getenv("LISTEN_PORT");
+
+  if (!allocateFrameQueue(NODE_FRAME_SLOT_SIZE) || !beginStreamReceiver()) return 1;
+
+  // Sum of FNV-1a hashes of the decoded frames: nodes that decoded the same
+  // frames print the same checksum
+  uint32_t frames = 0;
+  uint32_t checksum = 0;
+  unsigned long lastStatsMs = millis();
+  for (;;) {
+    FrameSlot* slot = waitFrameSlot(10);
+    if (slot) {
+      unsigned long start = micros();
+      uint32_t queueUs = start - slot->readyUs;
+      uint32_t hash = 2166136261u;
+      for (size_t i = 0; i < slot->size; i++) hash = (hash ^ slot->data[i]) * 16777619u;
+      checksum += hash;
+      frames++;
+      delay(decodeMs);
+      sendFrameAck(slot->seq, slot->size, queueUs, micros() - start);
+      releaseFrameSlot(slot);
+    }
+
+    if (millis() - lastStatsMs >= NODE_STATS_MS) {
+      Serial.printf("[%s] decoded %u frames, checksum %08x, dropped %u\n", port ? port : "-", frames, checksum,
+                    framesDropped());
+      printRelayStats();
+      lastStatsMs = millis();
+    }
+  }
+}
@@ -0,0 +1,35 @@
+"""Move TJpgDec's hot functions and tables from flash into internal RAM.
+
+PlatformIO post script for env:lilka_v2_iram (see include/hot_path.h).
+The library is compiled with -ffunction-sections and -fdata-sections, so
+every function and table sits in its own section. Renaming those sections
+to .iram1.* and .dram1.* makes the ESP-IDF linker script place them in IRAM
+and DRAM. Names missing from a future library version are simply not
+renamed, so an update can only lose the optimisation, not break the build.
+"""
+import os
+
+Import("env")  # noqa: F821
+
+# Huffman decoding, IDCT, and YCbCr -> RGB565 conversion plus output
+HOT_FUNCTIONS = ("huffext", "bitext", "block_idct", "mcu_load", "mcu_output")
+# Zigzag order, IDCT scale factors and the saturation table
+HOT_TABLES = ("Zig", "Ipsf", "Clip8")
+
+
+def rename_args():
+    args = []
+    for name in HOT_FUNCTIONS:
+        args += ["--rename-section", f".text.{name}=.iram1.text.{name}",
+                 "--rename-section", f".literal.{name}=.iram1.literal.{name}"]
+    for name in HOT_TABLES:
+        args += ["--rename-section", f".rodata.{name}=.dram1.rodata.{name}"]
+    return " ".join(args)
+
+
+for builder in env.GetLibBuilders():  # noqa: F821
+    if builder.name != "TJpg_Decoder":
+        continue
+    obj = os.path.join(builder.build_dir, "tjpgd.c.o")
+    env.AddPostAction(obj, env.VerboseAction(  # noqa: F821
+        f'"$OBJCOPY" {rename_args()} $TARGET', "Placing TJpgDec hot path in IRAM"))
@@ -0,0 +1,95 @@
+#!/usr/bin/env python3
+"""Generate the JPEG corpus embedded in the firmware for the self-benchmark.
+
+Three kinds of content at the display size - dense text, a photo-like
+landscape and a flat-coloured UI - each at qualities 30, 50 and 80, plus a
+half-size UI frame that exercises the 2x upscaled layout. Everything is
+drawn procedurally from fixed seeds, so the corpus can be regenerated, but
+the committed files are what the firmware embeds: a different Pillow or
+libjpeg may encode slightly different bytes, and the benchmark prints a
+corpus checksum so that fingerprints are only compared on the same corpus.
+
+Usage: python3 scripts/make_bench_corpus.py   (writes assets/bench/*.jpg)
+"""
+import os
+
+import numpy as np
+from PIL import Image, ImageDraw, ImageFont
+
+WIDTH, HEIGHT = 280, 240
+QUALITIES = (30, 50, 80)
+OUT_DIR = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "assets", "bench")
+
+WORDS = ("frame decode stream lilka mjpeg buffer socket display pixel block "
+         "huffman quality latency network packet window cursor").split()
+
+
+def text_page():
+    img = Image.new("RGB", (WIDTH, HEIGHT), (250, 250, 246))
+    draw = ImageDraw.Draw(img)
+    rng = np.random.default_rng(1)
+    y = 4
+    while y < HEIGHT - 10:
+        size = 14 if rng.random() < 0.15 else 10
+        font = ImageFont.load_default(size)
+        line = " ".join(rng.choice(WORDS, 8))
+        draw.text((6, y), line, fill=(20, 20, 30) if size == 10 else (40, 60, 160), font=font)
+        y += size + 3
+    return img
+
+
+def fractal_noise(rng, octaves=8):
+    noise = np.zeros((HEIGHT, WIDTH))
+    for octave in range(octaves):
+        cells = 2 ** (octave + 2)
+        grid = rng.random((cells + 1, cells + 1))
+        layer = Image.fromarray((grid * 255).astype(np.uint8)).resize((WIDTH, HEIGHT), Image.BICUBIC)
+        noise += np.asarray(layer, dtype=np.float64) / 255.0 / 2 ** octave
+    return noise / noise.max()
+
+
+def photo():
+    rng = np.random.default_rng(2)
+    y = np.linspace(0.0, 1.0, HEIGHT)[:, None]
+    sky = np.stack([120 + 100 * y, 170 + 60 * y, np.full_like(y, 240)], -1) * np.ones((1, WIDTH, 1))
+    ground = fractal_noise(rng) * 0.6 + rng.random((HEIGHT, WIDTH)) * 0.4  # Foliage
+    horizon = 0.45 + 0.2 * fractal_noise(rng, 3)[0][None, :]
+    land = np.stack([40 + 140 * ground, 70 + 150 * ground, 30 + 70 * ground], -1)
+    mask = (y > horizon)[..., None]
+    rgb = np.where(mask, land, sky)
+    rgb += rng.normal(0.0, 6.0, rgb.shape)  # Sensor grain
+    return Image.fromarray(np.clip(rgb, 0, 255).astype(np.uint8))
+
+
+def ui(width=WIDTH, height=HEIGHT):
+    img = Image.new("RGB", (width, height), (45, 52, 64))
+    draw = ImageDraw.Draw(img)
+    font = ImageFont.load_default(10)
+    rng = np.random.default_rng(3)
+    draw.rectangle([0, 0, width, 14], fill=(30, 34, 42))
+    draw.text((4, 2), "Lilka  12:34  WiFi", fill=(230, 230, 230), font=font)
+    for i in range(6):
+        x, y = 8 + (i % 3) * (width // 3), 24 + (i // 3) * 50
+        colour = tuple(int(c) for c in rng.integers(60, 230, 3))
+        draw.rounded_rectangle([x, y, x + width // 3 - 16, y + 36], 6, fill=colour)
+        draw.text((x + 6, y + 12), f"App {i + 1}", fill=(255, 255, 255), font=font)
+    draw.rectangle([8, height - 80, width - 8, height - 8], fill=(236, 238, 242), outline=(90, 90, 90))
+    for row in range(4):
+        draw.text((14, height - 74 + row * 16), f"Setting {row + 1}: {' '.join(rng.choice(WORDS, 2))}",
+                  fill=(30, 30, 30), font=font)
+    return img
+
+
+def main():
+    os.makedirs(OUT_DIR, exist_ok=True)
+    images = {"text": text_page(), "photo": photo(), "ui": ui()}
+    for name, img in images.items():
+        for quality in QUALITIES:
+            img.save(os.path.join(OUT_DIR, f"{name}_q{quality}.jpg"), "JPEG",
+                     quality=quality, subsampling="4:2:0")
+    ui(WIDTH // 2, HEIGHT // 2).save(os.path.join(OUT_DIR, "ui_half_q50.jpg"), "JPEG",
+                                     quality=50, subsampling="4:2:0")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,102 @@
+#!/bin/bash
+#
+# Streams through a chain (or tree) of host-built receivers on localhost, to
+# check relaying without devices. Each node prints how many frames it
+# decoded and a checksum over them every 2 seconds; nodes that kept up print
+# the same checksum as the first one.
+#
+# Usage: scripts/relay_chain.sh [NODES] [SECONDS]
+#
+#   NODES      receivers, on ports 9001, 9002, ... (default: 3)
+#   SECONDS    how long to stream (default: 10)
+#
+# Environment:
+#   FANOUT=2      relay as a binary tree instead of a chain
+#   SLOW=1        add a last downstream that reads at ~20 KB/s; only it
+#                 should lose frames
+#   TILES=1       send tiled frames (needs python3-numpy and python3-pil), so
+#                 a slow hop also triggers refreshes, at most one per second
+#   DECODE_MS=10  per-frame "decode" time of each node
+#   NODE=path     receiver binary (default: built with pio run -e native_relay)
+#
+
+set -e
+
+NODES="${1:-3}"
+SECONDS_TO_RUN="${2:-10}"
+FANOUT="${FANOUT:-1}"
+SLOW="${SLOW:-0}"
+TILES="${TILES:-0}"
+export DECODE_MS="${DECODE_MS:-10}"
+FIRST_PORT=9001
+FPS=15
+
+cd "$(dirname "$0")/.."
+if [ -z "$NODE" ]; then
+    pio run -e native_relay
+    NODE=.pio/build/native_relay/program
+fi
+
+LOGS="$(mktemp -d)"
+PIDS=()
+trap 'kill "${PIDS[@]}" 2>/dev/null; wait 2>/dev/null' EXIT
+
+RELAYS=()
+for i in $(seq 0 $((NODES - 1))); do
+    PORT=$((FIRST_PORT + i))
+    LISTEN_PORT=$PORT "$NODE" > "$LOGS/$PORT.log" 2>&1 &
+    PIDS+=($!)
+    [ "$i" -gt 0 ] && RELAYS+=(--relay "127.0.0.1:$PORT")
+done
+
+if [ "$SLOW" = "1" ]; then
+    SLOW_PORT=$((FIRST_PORT + NODES))
+    python3 - "$SLOW_PORT" > "$LOGS/$SLOW_PORT.log" 2>&1 <<'PY' &
+import socket, sys, time
+server = socket.socket()
+server.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+server.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, 8192)
+server.bind(("127.0.0.1", int(sys.argv[1])))
+server.listen(1)
+conn, _ = server.accept()
+while conn.recv(2048):
+    time.sleep(0.1)
+PY
+    PIDS+=($!)
+    RELAYS+=(--relay "127.0.0.1:$SLOW_PORT")
+fi
+sleep 0.5
+
+FRAMES=$((SECONDS_TO_RUN * FPS))
+if [ "$TILES" = "1" ]; then
+    # A bar moving over a static gradient, so only some tiles change
+    python3 - "$FRAMES" "$FPS" <<'PY' | python3 host/lilka_sender.py "127.0.0.1:$FIRST_PORT" "${RELAYS[@]}" \
+        --relay-fanout "$FANOUT" --source raw --tiles --fps "$FPS"
+import sys, time
+import numpy as np
+frames, fps = int(sys.argv[1]), int(sys.argv[2])
+base = np.zeros((240, 280, 3), np.uint8)
+base[:, :, 0] = np.arange(280) * 255 // 280
+for n in range(frames):
+    frame = base.copy()
+    x = n * 4 % 260
+    frame[:, x:x + 20] = 255
+    sys.stdout.buffer.write(frame.tobytes())
+    sys.stdout.buffer.flush()
+    time.sleep(1 / fps)
+PY
+else
+    JPEGS=(assets/bench/*.jpg)
+    INTERVAL="$(awk "BEGIN { print 1 / $FPS }")"
+    for n in $(seq 0 $((FRAMES - 1))); do
+        cat "${JPEGS[n % ${#JPEGS[@]}]}"
+        sleep "$INTERVAL"
+    done | python3 host/lilka_sender.py "127.0.0.1:$FIRST_PORT" "${RELAYS[@]}" --relay-fanout "$FANOUT"
+fi
+sleep 2.5
+
+for log in "$LOGS"/*.log; do
+    echo "== $(basename "$log" .log)"
+    grep -E "decoded|Relay|hop" "$log" | tail -n 4 || true
+done
+rm -rf "$LOGS"
@@ -0,0 +1,58 @@
+#include "coop_scheduler.h"
+
+struct CoopTask {
+  const char* name;
+  CoopStep step;
+  bool running;
+  unsigned long lastRunUs;
+  uint32_t maxGapUs;
+};
+
+static CoopTask tasks[COOP_MAX_TASKS];
+static int taskCount = 0;
+static unsigned long lastYieldUs = 0;
+
+bool coopAdd(const char* name, CoopStep step) {
+  if (taskCount >= COOP_MAX_TASKS) return false;
+  tasks[taskCount] = {name, step, false, micros(), 0};
+  taskCount++;
+  return true;
+}
+
+static bool runTask(CoopTask* task) {
+  if (task->running) return false;
+  unsigned long now = micros();
+  uint32_t gap = now - task->lastRunUs;
+  if (gap > task->maxGapUs) task->maxGapUs = gap;
+
+  task->running = true;
+  bool progressed = task->step();
+  task->running = false;
+  task->lastRunUs = micros();
+  return progressed;
+}
+
+bool coopRunOnce() {
+  bool progressed = false;
+  for (int i = 0; i < taskCount; i++) {
+    progressed |= runTask(&tasks[i]);
+  }
+  lastYieldUs = micros();
+  return progressed;
+}
+
+void coopYield() {
+  if (micros() - lastYieldUs < COOP_MIN_SLICE_US) return;
+  coopRunOnce();
+}
+
+uint32_t coopTakeMaxGap(const char* name) {
+  for (int i = 0; i < taskCount; i++) {
+    if (strcmp(tasks[i].name, name) == 0) {
+      uint32_t gap = tasks[i].maxGapUs;
+      tasks[i].maxGapUs = 0;
+      return gap;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,206 @@
+#include "display_calibration.h"
+#include "frame_layout.h"
+#include <lilka.h>
+#include <Preferences.h>
+#include <esp_heap_caps.h>
+
+// ESP32-S3 SPI clocks are 80 MHz divided by an integer
+static const uint32_t CANDIDATE_HZ[] = {26666666, 40000000, 80000000};
+#define CANDIDATE_COUNT (sizeof(CANDIDATE_HZ) / sizeof(CANDIDATE_HZ[0]))
+#define SAFE_HZ 40000000  // Prompts are always drawn at this clock
+#define REPEATS 5
+#define MCU_SIZE 16
+#define STRIP_COUNT (DISPLAY_HEIGHT / MCU_SIZE)
+
+// Arduino_GFX has no call that only changes the SPI clock, and begin()
+// also resets the panel and runs its init sequence again. Restarting just
+// the display's bus at the new clock leaves the panel as lilka::begin() set
+// it up (rotation, address window).
+struct DisplayBus : lilka::Display {
+  static Arduino_DataBus* get() { return lilka::display.*(&DisplayBus::_bus); }
+};
+
+static void setDisplayClock(uint32_t hz) {
+  static uint32_t currentHz = 0;
+  if (hz == currentHz) return;
+  DisplayBus::get()->begin(hz);
+  currentHz = hz;
+}
+
+// Time to push one 280x240 frame each way, in microseconds
+struct PushTiming {
+  uint32_t blockUs;        // 16x16 blocks from SRAM (one push per MCU)
+  uint32_t stripUs;        // 280x16 strips from SRAM (one push per MCU row)
+  uint32_t stripPsramUs;   // 280x16 strips straight from PSRAM
+  uint32_t frameUs;        // The whole frame from PSRAM in one push
+};
+
+// Colour bars over a one-pixel checkerboard: SPI errors at a too-fast clock
+// show up as noise in the checkerboard and wrong colours in the bars
+static uint16_t patternPixel(int x, int y) {
+  static const uint16_t BARS[] = {
+    lilka::colors::White, lilka::colors::Yellow, lilka::colors::Cyan, lilka::colors::Green,
+    0xF81F, lilka::colors::Red, 0x001F, lilka::colors::Black,
+  };
+  if (y < DISPLAY_HEIGHT / 2) return BARS[x * 8 / DISPLAY_WIDTH];
+  if (y < DISPLAY_HEIGHT * 3 / 4) return ((x ^ y) & 1) ? lilka::colors::White : lilka::colors::Black;
+  return (x & 0x1F) << 11 | (y & 0x3F) << 5 | (x >> 3 & 0x1F);  // Gradients
+}
+
+static void showMessage(const char* title, const char* line1, const char* line2) {
+  lilka::display.fillScreen(lilka::colors::Black);
+  lilka::display.setTextSize(1);
+  lilka::display.setTextColor(lilka::colors::White);
+  lilka::display.setCursor(10, 60);
+  lilka::display.println(title);
+  lilka::display.setTextColor(lilka::colors::Cyan);
+  lilka::display.setCursor(10, 100);
+  lilka::display.println(line1);
+  lilka::display.setCursor(10, 120);
+  lilka::display.println(line2);
+}
+
+static bool waitForAnswer() {
+  lilka::controller.resetState();
+  for (;;) {
+    lilka::State state = lilka::controller.getState();
+    if (state.a.justPressed) return true;
+    if (state.b.justPressed) return false;
+    vTaskDelay(pdMS_TO_TICKS(10));
+  }
+}
+
+static uint32_t timeBlocks(uint16_t* block) {
+  unsigned long start = micros();
+  for (int y = 0; y < DISPLAY_HEIGHT; y += MCU_SIZE) {
+    for (int x = 0; x < DISPLAY_WIDTH; x += MCU_SIZE) {
+      lilka::display.draw16bitRGBBitmap(x, y, block, min(MCU_SIZE, DISPLAY_WIDTH - x), MCU_SIZE);
+    }
+  }
+  return micros() - start;
+}
+
+static uint32_t timeStrips(uint16_t* strip) {
+  unsigned long start = micros();
+  for (int y = 0; y < DISPLAY_HEIGHT; y += MCU_SIZE) {
+    lilka::display.draw16bitRGBBitmap(0, y, strip, DISPLAY_WIDTH, MCU_SIZE);
+  }
+  return micros() - start;
+}
+
+static void measure(uint16_t* block, uint16_t* strip, uint16_t* frame, PushTiming* timing) {
+  memset(timing, 0, sizeof(PushTiming));
+  for (int i = 0; i < REPEATS; i++) {
+    timing->blockUs += timeBlocks(block);
+    timing->stripUs += timeStrips(strip);
+    unsigned long start = micros();
+    for (int y = 0; y < DISPLAY_HEIGHT; y += MCU_SIZE) {
+      lilka::display.draw16bitRGBBitmap(0, y, frame + y * DISPLAY_WIDTH, DISPLAY_WIDTH, MCU_SIZE);
+    }
+    timing->stripPsramUs += micros() - start;
+    start = micros();
+    lilka::display.draw16bitRGBBitmap(0, 0, frame, DISPLAY_WIDTH, DISPLAY_HEIGHT);
+    timing->frameUs += micros() - start;
+  }
+  timing->blockUs /= REPEATS;
+  timing->stripUs /= REPEATS;
+  timing->stripPsramUs /= REPEATS;
+  timing->frameUs /= REPEATS;
+}
+
+static void printTiming(uint32_t hz, const PushTiming* t) {
+  Serial.printf("SPI %2u MHz | block %5.1fms (%4.1f fps) | strip %5.1fms (%4.1f fps) | "
+                "PSRAM strip %5.1fms | full frame %5.1fms (%4.1f fps)\n",
+                hz / 1000000, t->blockUs / 1000.0f, 1e6f / t->blockUs,
+                t->stripUs / 1000.0f, 1e6f / t->stripUs, t->stripPsramUs / 1000.0f,
+                t->frameUs / 1000.0f, 1e6f / t->frameUs);
+}
+
+void runDisplayCalibration() {
+  uint16_t* block = (uint16_t*)heap_caps_malloc(MCU_SIZE * MCU_SIZE * 2, MALLOC_CAP_INTERNAL | MALLOC_CAP_DMA);
+  uint16_t* strip = (uint16_t*)heap_caps_malloc(DISPLAY_WIDTH * MCU_SIZE * 2, MALLOC_CAP_INTERNAL | MALLOC_CAP_DMA);
+  uint16_t* frame = (uint16_t*)heap_caps_malloc(DISPLAY_WIDTH * DISPLAY_HEIGHT * 2, MALLOC_CAP_SPIRAM);
+  if (!block || !strip || !frame) {
+    showMessage("Calibration", "Not enough memory", "(needs PSRAM)");
+    delay(2000);
+    heap_caps_free(block);
+    heap_caps_free(strip);
+    heap_caps_free(frame);
+    return;
+  }
+
+  for (int y = 0; y < DISPLAY_HEIGHT; y++) {
+    for (int x = 0; x < DISPLAY_WIDTH; x++) {
+      frame[y * DISPLAY_WIDTH + x] = patternPixel(x, y);
+    }
+  }
+  memcpy(strip, frame, DISPLAY_WIDTH * MCU_SIZE * 2);
+  for (int y = 0; y < MCU_SIZE; y++) {
+    memcpy(block + y * MCU_SIZE, frame + y * DISPLAY_WIDTH, MCU_SIZE * 2);
+  }
+
+  Serial.println("Display calibration");
+  uint32_t bestHz = 0;
+  PushTiming best;
+  for (size_t i = 0; i < CANDIDATE_COUNT; i++) {
+    uint32_t hz = CANDIDATE_HZ[i];
+    setDisplayClock(hz);
+    PushTiming timing;
+    measure(block, strip, frame, &timing);
+    printTiming(hz, &timing);
+
+    // Leave the pattern up, then ask at the safe clock
+    lilka::display.draw16bitRGBBitmap(0, 0, frame, DISPLAY_WIDTH, DISPLAY_HEIGHT);
+    delay(2000);
+    setDisplayClock(SAFE_HZ);
+    char line[40];
+    snprintf(line, sizeof(line), "Pattern at %u MHz clean?", hz / 1000000);
+    showMessage("Display calibration", line, "A - yes, B - no");
+    if (!waitForAnswer()) break;  // Faster clocks will not do better
+    bestHz = hz;
+    best = timing;
+  }
+
+  heap_caps_free(block);
+  heap_caps_free(strip);
+  heap_caps_free(frame);
+
+  if (bestHz == 0) {
+    showMessage("Display calibration", "No clock passed,", "keeping defaults");
+    delay(2000);
+    return;
+  }
+
+  bool batching = best.stripUs < best.blockUs;
+  Preferences prefs;
+  prefs.begin(SETTINGS_NAMESPACE, false);
+  prefs.putUInt("spi_hz", bestHz);
+  prefs.putBool("batch", batching);
+  prefs.putUInt("fps_strip", 1e7f / best.stripUs);  // x10
+  prefs.putUInt("fps_full", 1e7f / best.frameUs);
+  prefs.end();
+
+  char line1[40], line2[40];
+  snprintf(line1, sizeof(line1), "SPI %u MHz saved", bestHz / 1000000);
+  snprintf(line2, sizeof(line2), "Max %.0f fps strips, %.0f full", 1e6f / best.stripUs, 1e6f / best.frameUs);
+  showMessage("Display calibration", line1, line2);
+  Serial.printf("Saved SPI %u MHz, %s output\n", bestHz / 1000000, batching ? "strip" : "per-block");
+  delay(3000);
+}
+
+bool applyDisplaySettings() {
+  Preferences prefs;
+  if (!prefs.begin(SETTINGS_NAMESPACE, true)) return false;
+  uint32_t hz = prefs.getUInt("spi_hz", 0);
+  bool batching = prefs.getBool("batch", true);
+  uint32_t fpsStrip = prefs.getUInt("fps_strip", 0);
+  uint32_t fpsFull = prefs.getUInt("fps_full", 0);
+  prefs.end();
+  if (hz == 0) return false;
+
+  setDisplayClock(hz);
+  setFrameBatching(batching);
+  Serial.printf("Display: SPI %u MHz (calibrated), push ceiling %.1f fps in strips, %.1f fps as full frames\n",
+                hz / 1000000, fpsStrip / 10.0f, fpsFull / 10.0f);
+  return true;
+}
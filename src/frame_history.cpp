@@ -0,0 +1,178 @@
+#include "frame_history.h"
+#include <esp_heap_caps.h>
+
+// Compact index entry: 12 bytes per frame, kept in internal RAM
+struct HistoryEntry {
+  uint32_t offset;
+  uint32_t timeMs;
+  uint32_t size : 24;
+  uint32_t quality : 8;  // Estimated JPEG quality, 0 if unknown
+};
+
+enum ViewerState { VIEW_LIVE, VIEW_PAUSED, VIEW_REPLAY };
+
+static uint8_t* ring = nullptr;
+static uint32_t writePos = 0;
+static HistoryEntry entries[HISTORY_FRAMES];
+static uint16_t oldest = 0;
+static uint16_t count = 0;
+
+static ViewerState state = VIEW_LIVE;
+static uint16_t cursor = 0;  // Position from the oldest entry
+static unsigned long replayStartMs = 0;
+static uint32_t replayBaseMs = 0;
+
+static HistoryEntry* entryAt(uint16_t pos) {
+  return &entries[(oldest + pos) % HISTORY_FRAMES];
+}
+
+static void evictOldest() {
+  oldest = (oldest + 1) % HISTORY_FRAMES;
+  count--;
+}
+
+// Libjpeg-style encoders scale a standard table by quality, so the first
+// luminance quantizer (16 at quality 50) is enough to estimate it
+static uint8_t jpegQuality(const uint8_t* data, size_t len) {
+  size_t pos = 2;
+  while (pos + 5 < len && data[pos] == 0xFF) {
+    uint8_t marker = data[pos + 1];
+    size_t segment = (data[pos + 2] << 8) | data[pos + 3];
+    if (marker == 0xDB) {
+      if (data[pos + 4] >> 4) return 0;  // 16-bit tables
+      uint32_t scale = (data[pos + 5] * 100 + 8) / 16;
+      if (scale == 0) return 100;
+      int quality = scale <= 100 ? (200 - scale) / 2 : 5000 / scale;
+      return constrain(quality, 1, 100);
+    }
+    if (marker == 0xDA) break;
+    pos += 2 + segment;
+  }
+  return 0;
+}
+
+bool beginFrameHistory() {
+  ring = (uint8_t*)heap_caps_malloc(HISTORY_BYTES, MALLOC_CAP_SPIRAM);
+  if (!ring) {
+    Serial.println("No PSRAM for frame history");
+    return false;
+  }
+  Serial.printf("Frame history: %dKB, up to %d s\n", HISTORY_BYTES / 1024, HISTORY_SECONDS);
+  return true;
+}
+
+void recordHistoryFrame(const uint8_t* data, size_t size) {
+  if (!ring || state != VIEW_LIVE || size > HISTORY_BYTES / 4) return;
+
+  unsigned long now = millis();
+  while (count > 0 && (count == HISTORY_FRAMES
+                       || now - entryAt(0)->timeMs > HISTORY_SECONDS * 1000UL)) {
+    evictOldest();
+  }
+
+  // Frames are stored contiguously; wrap when the tail is too short. Entries
+  // left past the wrap point are from the previous lap, so the oldest.
+  if (writePos + size > HISTORY_BYTES) {
+    while (count > 0 && entryAt(0)->offset >= writePos) evictOldest();
+    writePos = 0;
+  }
+  while (count > 0) {
+    HistoryEntry* entry = entryAt(0);
+    if (entry->offset >= writePos + size || entry->offset + entry->size <= writePos) break;
+    evictOldest();
+  }
+
+  memcpy(ring + writePos, data, size);
+  HistoryEntry* entry = &entries[(oldest + count) % HISTORY_FRAMES];
+  entry->offset = writePos;
+  entry->timeMs = now;
+  entry->size = size;
+  entry->quality = jpegQuality(data, size);
+  count++;
+  writePos += size;
+}
+
+static bool frameAt(uint16_t pos, HistoryFrame* frame) {
+  if (pos >= count) return false;
+  HistoryEntry* entry = entryAt(pos);
+  frame->data = ring + entry->offset;
+  frame->size = entry->size;
+  return true;
+}
+
+bool historyActive() {
+  return state != VIEW_LIVE;
+}
+
+bool historyPause() {
+  if (count == 0) return false;
+  state = VIEW_PAUSED;
+  cursor = count - 1;
+  Serial.printf("History paused: %u frames\n", count);
+  return true;
+}
+
+bool historyStep(int delta, HistoryFrame* frame) {
+  if (state == VIEW_LIVE) return false;
+  state = VIEW_PAUSED;
+  int pos = constrain((int)cursor + delta, 0, (int)count - 1);
+  if (pos == cursor) return false;
+  cursor = pos;
+  return frameAt(cursor, frame);
+}
+
+bool historyReplay() {
+  if (count == 0) return false;
+  if (state == VIEW_LIVE) cursor = 0;
+  state = VIEW_REPLAY;
+  replayStartMs = millis();
+  replayBaseMs = entryAt(cursor)->timeMs;
+  return true;
+}
+
+// Replay keeps the recorded frame timing
+bool historyNextReplayFrame(HistoryFrame* frame) {
+  if (state != VIEW_REPLAY) return false;
+  if (cursor >= count) {
+    cursor = count - 1;
+    state = VIEW_PAUSED;
+    return false;
+  }
+  if (millis() - replayStartMs < entryAt(cursor)->timeMs - replayBaseMs) return false;
+  frameAt(cursor++, frame);
+  return true;
+}
+
+void historyResume() {
+  state = VIEW_LIVE;
+}
+
+void printHistoryStats() {
+  if (count < 2) return;
+
+  // Each frame covers the time until the next one
+  uint32_t bytes[11] = {0};
+  uint32_t spanMs[11] = {0};
+  uint32_t total = 0;
+  for (uint16_t i = 0; i + 1 < count; i++) {
+    HistoryEntry* entry = entryAt(i);
+    uint8_t bucket = (entry->quality + 5) / 10;
+    bytes[bucket] += entry->size;
+    spanMs[bucket] += entryAt(i + 1)->timeMs - entry->timeMs;
+    total += entry->size;
+  }
+  total += entryAt(count - 1)->size;
+
+  float seconds = (entryAt(count - 1)->timeMs - entryAt(0)->timeMs) / 1000.0f;
+  Serial.printf("History: %.1fs, %u frames, %uKB |", seconds, count, total / 1024);
+  for (uint8_t bucket = 0; bucket <= 10; bucket++) {
+    if (spanMs[bucket] == 0) continue;
+    uint32_t rate = bytes[bucket] * 1000 / spanMs[bucket] / 1024;
+    if (bucket) {
+      Serial.printf(" q%u: %uKB/s", bucket * 10, rate);
+    } else {
+      Serial.printf(" q?: %uKB/s", rate);  // Quality could not be estimated
+    }
+  }
+  Serial.println();
+}
@@ -0,0 +1,302 @@
+#include "frame_layout.h"
+#include "osd.h"
+#include "hot_path.h"
+#include <lilka.h>
+
+// TJpgDec outputs one MCU (at most 16x16) per callback
+#define MCU_MAX 16
+
+static uint16_t frameW = 0;
+static uint16_t frameH = 0;
+static uint8_t scale = 1;
+static int16_t offsetX = 0;
+static int16_t offsetY = 0;
+
+// Inset rectangle; it touches the right and bottom display edges
+static int16_t insetX = DISPLAY_WIDTH;
+static int16_t insetY = DISPLAY_HEIGHT;
+static bool insetDrawing = false;
+
+// Upscaled MCU, in internal RAM
+static uint16_t scaleBuffer[MCU_MAX * LAYOUT_MAX_SCALE * MCU_MAX * LAYOUT_MAX_SCALE];
+
+// Every push re-sends the column/row address window and a RAM write command,
+// which costs about as much as a 16x16 block of pixels. Consecutive blocks
+// of one MCU row are therefore collected in a strip (upscaled on the way in)
+// and pushed together, once per row on full frames.
+#define STRIP_ROWS (MCU_MAX * LAYOUT_MAX_SCALE)
+static uint16_t strip[DISPLAY_WIDTH * STRIP_ROWS];
+static uint16_t stripStride = DISPLAY_WIDTH;  // Visible frame (or inset) width
+static int16_t stripRight = DISPLAY_WIDTH;
+static int16_t runX = 0;
+static int16_t runY = 0;
+static uint16_t runW = 0;
+static uint16_t runH = 0;
+static bool batching = true;
+
+static uint32_t pushCount = 0;
+static uint32_t pushUs = 0;
+
+// Runs end at the right edge of the visible frame
+static void setPrimaryStrip() {
+  stripStride = frameW ? min((int)(frameW * scale), DISPLAY_WIDTH - offsetX) : DISPLAY_WIDTH;
+  stripRight = offsetX + stripStride;
+}
+
+static void HOT_IRAM pushPixels(int16_t x, int16_t y, uint16_t* pixels, uint16_t w, uint16_t h) {
+  unsigned long start = micros();
+  lilka::display.draw16bitRGBBitmap(x, y, pixels, w, h);
+  pushUs += micros() - start;
+  pushCount++;
+}
+
+// Read the frame size from the SOF marker without preparing the decoder
+bool jpegFrameSize(const uint8_t* data, size_t len, uint16_t* w, uint16_t* h) {
+  if (len < 4 || data[0] != 0xFF || data[1] != 0xD8) return false;
+  size_t pos = 2;
+  while (pos + 9 < len) {
+    if (data[pos] != 0xFF) return false;
+    uint8_t marker = data[pos + 1];
+    if (marker == 0xFF) {  // Fill byte
+      pos++;
+      continue;
+    }
+    size_t segment = (data[pos + 2] << 8) | data[pos + 3];
+    if (marker >= 0xC0 && marker <= 0xC2) {
+      *h = (data[pos + 5] << 8) | data[pos + 6];
+      *w = (data[pos + 7] << 8) | data[pos + 8];
+      return true;
+    }
+    if (marker == 0xDA) return false;  // Scan data before any SOF
+    pos += 2 + segment;
+  }
+  return false;
+}
+
+static void clearRect(int16_t x, int16_t y, int16_t w, int16_t h) {
+  if (w > 0 && h > 0) {
+    lilka::display.fillRect(x, y, w, h, lilka::colors::Black);
+  }
+}
+
+bool setFrameLayout(uint16_t w, uint16_t h) {
+  flushFrameBlocks();
+  if (w == frameW && h == frameH) return false;
+  bool replaced = frameW != 0;
+
+  uint8_t s = 1;
+  if (w > 0 && h > 0) {
+    s = min(DISPLAY_WIDTH / w, DISPLAY_HEIGHT / h);
+    s = constrain(s, 1, LAYOUT_MAX_SCALE);
+  }
+  int16_t scaledW = w * s;
+  int16_t scaledH = h * s;
+  frameW = w;
+  frameH = h;
+  scale = s;
+  offsetX = max(0, (DISPLAY_WIDTH - scaledW) / 2);
+  offsetY = max(0, (DISPLAY_HEIGHT - scaledH) / 2);
+  setPrimaryStrip();
+
+  // The frame itself overwrites its own area, so only the bars are cleared
+  int16_t right = offsetX + scaledW;
+  int16_t bottom = offsetY + scaledH;
+  clearRect(0, 0, DISPLAY_WIDTH, offsetY);
+  clearRect(0, bottom, DISPLAY_WIDTH, DISPLAY_HEIGHT - bottom);
+  clearRect(0, offsetY, offsetX, scaledH);
+  clearRect(right, offsetY, DISPLAY_WIDTH - right, scaledH);
+  osdBackgroundCleared();
+
+  Serial.printf("Frame layout %ux%u, scale %u, offset %d,%d\n", w, h, s, offsetX, offsetY);
+  return replaced;
+}
+
+// Forget the layout, e.g. after drawing the waiting screen, so the next
+// frame clears its bars again
+void resetFrameLayout() {
+  runW = 0;
+  frameW = frameH = 0;
+  scale = 1;
+  offsetX = offsetY = 0;
+  setPrimaryStrip();
+  osdBackgroundCleared();
+}
+
+// Push the top-left drawW x drawH part of a w-wide block, repacking the rows
+// in place when the block is clipped on the right
+static void HOT_IRAM pushClipped(int16_t x, int16_t y, uint16_t* pixels, uint16_t w,
+                        uint16_t drawW, uint16_t drawH) {
+  if (drawW == 0 || drawH == 0) return;
+  if (drawW < w) {
+    for (uint16_t row = 1; row < drawH; row++) {
+      memmove(pixels + row * drawW, pixels + row * w, drawW * sizeof(uint16_t));
+    }
+  }
+  pushPixels(x, y, pixels, drawW, drawH);
+}
+
+// Push a primary block, leaving out the part under the inset: what remains
+// is the rows above the inset plus the columns to its left
+void HOT_IRAM drawDisplayBlock(int16_t x, int16_t y, uint16_t* pixels, uint16_t w, uint16_t h) {
+  osdComposite(x, y, w, h, pixels);
+  if (x + w <= insetX || y + h <= insetY) {
+    pushPixels(x, y, pixels, w, h);
+    return;
+  }
+  uint16_t above = max(0, insetY - y);
+  uint16_t left = max(0, insetX - x);
+  if (above > 0) pushPixels(x, y, pixels, w, above);
+  pushClipped(x, y + above, pixels + above * w, w, left, h - above);
+}
+
+static void addStripBlock(int16_t dx, int16_t dy, uint16_t w, uint16_t drawW, uint16_t drawH,
+                          const uint16_t* bitmap, uint8_t s);
+
+static bool HOT_IRAM drawInsetBlock(int16_t x, int16_t y, uint16_t w, uint16_t h, uint16_t* bitmap) {
+  // Scaled frames may end in a partial block past the inset
+  if (x >= DISPLAY_WIDTH || y >= DISPLAY_HEIGHT) return true;
+  uint16_t drawW = min((int)w, DISPLAY_WIDTH - x);
+  uint16_t drawH = min((int)h, DISPLAY_HEIGHT - y);
+  if (batching && w <= MCU_MAX && h <= MCU_MAX) {
+    addStripBlock(x, y, w, drawW, drawH, bitmap, 1);
+  } else {
+    pushClipped(x, y, bitmap, w, drawW, drawH);
+  }
+  return true;
+}
+
+uint8_t setInsetLayout(uint16_t w, uint16_t h, bool* changed) {
+  uint8_t s = 2;
+  while (s <= 4 && (w / s > INSET_MAX_WIDTH || h / s > INSET_MAX_HEIGHT)) s *= 2;
+  if (s > 4 || w == 0 || h == 0) {
+    *changed = insetX < DISPLAY_WIDTH;
+    insetX = DISPLAY_WIDTH;
+    insetY = DISPLAY_HEIGHT;
+    return 0;
+  }
+
+  // TJpgDec rounds scaled sizes up
+  int16_t x = DISPLAY_WIDTH - (w + s - 1) / s;
+  int16_t y = DISPLAY_HEIGHT - (h + s - 1) / s;
+  *changed = x > insetX || y > insetY;  // The inset shrank
+  if (x != insetX || y != insetY) {
+    Serial.printf("Inset %ux%u at 1/%u scale\n", w, h, s);
+  }
+  insetX = x;
+  insetY = y;
+  return s;
+}
+
+void insetOrigin(int16_t* x, int16_t* y) {
+  *x = insetX;
+  *y = insetY;
+}
+
+void setInsetDrawing(bool drawing) {
+  flushFrameBlocks();
+  insetDrawing = drawing;
+  if (drawing) {
+    stripStride = DISPLAY_WIDTH - insetX;
+    stripRight = DISPLAY_WIDTH;
+  } else {
+    setPrimaryStrip();
+  }
+}
+
+void flushFrameBlocks() {
+  if (runW == 0) return;
+  if (runW < stripStride) {
+    for (uint16_t row = 1; row < runH; row++) {
+      memmove(strip + row * runW, strip + row * stripStride, runW * sizeof(uint16_t));
+    }
+  }
+  if (insetDrawing) {
+    pushPixels(runX, runY, strip, runW, runH);
+  } else {
+    drawDisplayBlock(runX, runY, strip, runW, runH);
+  }
+  runW = 0;
+}
+
+// Append a block to the strip, starting a new run unless it continues the
+// current one on the right
+static void HOT_IRAM addStripBlock(int16_t dx, int16_t dy, uint16_t w, uint16_t drawW, uint16_t drawH,
+                          const uint16_t* bitmap, uint8_t s) {
+  if (runW > 0 && (dy != runY || drawH != runH || dx != runX + runW
+                   || dx + drawW - runX > stripStride)) {
+    flushFrameBlocks();
+  }
+  if (runW == 0) {
+    runX = dx;
+    runY = dy;
+    runH = drawH;
+  }
+
+  uint16_t* out = strip + (dx - runX);
+  for (uint16_t row = 0; row < drawH; row++, out += stripStride) {
+    const uint16_t* src = bitmap + (row / s) * w;
+    if (s == 1) {
+      memcpy(out, src, drawW * sizeof(uint16_t));
+    } else {
+      for (uint16_t col = 0; col < drawW; col++) {
+        out[col] = src[col / s];
+      }
+    }
+  }
+  runW += drawW;
+
+  // Push as soon as the row reaches the right edge of the frame
+  if (dx + drawW >= stripRight) flushFrameBlocks();
+}
+
+void setFrameBatching(bool enabled) {
+  flushFrameBlocks();
+  batching = enabled;
+}
+
+bool frameBatchingEnabled() {
+  return batching;
+}
+
+void takeDisplayPushStats(uint32_t* pushes, uint32_t* us) {
+  *pushes = pushCount;
+  *us = pushUs;
+  pushCount = 0;
+  pushUs = 0;
+}
+
+bool HOT_IRAM drawFrameBlock(int16_t x, int16_t y, uint16_t w, uint16_t h, uint16_t* bitmap) {
+  if (insetDrawing) return drawInsetBlock(x, y, w, h, bitmap);
+
+  int16_t dx = offsetX + x * scale;
+  int16_t dy = offsetY + y * scale;
+
+  // Clip to display bounds
+  if (dx >= DISPLAY_WIDTH || dy >= DISPLAY_HEIGHT) return true;
+  uint16_t drawW = min((int)(w * scale), DISPLAY_WIDTH - dx);
+  uint16_t drawH = min((int)(h * scale), DISPLAY_HEIGHT - dy);
+
+  if (batching && w <= MCU_MAX && h <= MCU_MAX && drawW <= stripStride) {
+    addStripBlock(dx, dy, w, drawW, drawH, bitmap, scale);
+    return true;
+  }
+
+  // One push per block
+  if (scale == 1 && drawW == w) {
+    // Use Arduino_GFX fast bitmap drawing
+    drawDisplayBlock(dx, dy, bitmap, drawW, drawH);
+    return true;
+  }
+  if (w > MCU_MAX || h > MCU_MAX) return true;
+
+  // Replicate each pixel scale x scale times (also repacks clipped rows)
+  uint16_t* out = scaleBuffer;
+  for (uint16_t row = 0; row < drawH; row++) {
+    const uint16_t* src = bitmap + (row / scale) * w;
+    for (uint16_t col = 0; col < drawW; col++) {
+      *out++ = src[col / scale];
+    }
+  }
+  drawDisplayBlock(dx, dy, scaleBuffer, drawW, drawH);
+  return true;  // Continue decoding
+}
@@ -0,0 +1,164 @@
+#include "frame_prefetch.h"
+#include <esp_heap_caps.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+#if __has_include(<esp_async_memcpy.h>)
+#include <esp_async_memcpy.h>
+#define HAVE_ASYNC_MEMCPY 1
+#else
+#define HAVE_ASYNC_MEMCPY 0
+#endif
+
+#if CONFIG_IDF_TARGET_ESP32S3
+#include <esp32s3/rom/cache.h>
+#endif
+
+static uint8_t* staging[2] = {nullptr, nullptr};
+static SemaphoreHandle_t copyDone = nullptr;
+static bool prefetchEnabled = false;
+
+#if HAVE_ASYNC_MEMCPY
+static async_memcpy_t asyncCopy = nullptr;
+#endif
+
+// Ready frame whose copy into staging[pendingBuffer] has been started. It
+// stays in the ready queue, so when the receiver runs out of slots it is
+// still the one recycled first; its generation tells whether that happened.
+static FrameSlot* pendingSlot = nullptr;
+static uint32_t pendingGeneration = 0;
+static int pendingBuffer = 0;
+
+#if HAVE_ASYNC_MEMCPY
+static bool IRAM_ATTR onCopyDone(async_memcpy_t handle, async_memcpy_event_t* event, void* arg) {
+  BaseType_t woken = pdFALSE;
+  xSemaphoreGiveFromISR(copyDone, &woken);
+  return woken == pdTRUE;
+}
+#endif
+
+bool beginFramePrefetch() {
+  copyDone = xSemaphoreCreateBinary();
+  if (!copyDone) return false;
+
+  for (int i = 0; i < 2; i++) {
+    staging[i] = (uint8_t*)heap_caps_malloc(PREFETCH_BUFFER_SIZE, MALLOC_CAP_INTERNAL | MALLOC_CAP_DMA);
+    if (!staging[i]) {
+      Serial.println("No internal RAM for prefetch, decoding from PSRAM");
+      prefetchEnabled = false;
+      return true;
+    }
+  }
+
+#if HAVE_ASYNC_MEMCPY
+  async_memcpy_config_t config = ASYNC_MEMCPY_DEFAULT_CONFIG();
+  config.psram_trans_align = FRAME_SLOT_ALIGN;
+  config.sram_trans_align = 4;
+  if (esp_async_memcpy_install(&config, &asyncCopy) != ESP_OK) {
+    Serial.println("Async memcpy unavailable, prefetching with memcpy");
+    asyncCopy = nullptr;
+  }
+#endif
+
+  prefetchEnabled = true;
+  Serial.printf("Prefetch staging: 2 x %dKB internal SRAM\n", PREFETCH_BUFFER_SIZE / 1024);
+  return true;
+}
+
+void setFramePrefetch(bool enabled) {
+  prefetchEnabled = enabled && staging[0] && staging[1];
+}
+
+bool framePrefetchEnabled() {
+  return prefetchEnabled;
+}
+
+// Start copying a frame into a staging buffer; copyDone is given when the
+// copy is complete. Returns false if prefetch is off or the frame does not fit.
+static bool startCopy(FrameSlot* slot, int buffer) {
+  size_t size = slot->size;
+  size_t alignedSize = (size + FRAME_SLOT_ALIGN - 1) & ~(FRAME_SLOT_ALIGN - 1);
+  if (!prefetchEnabled || alignedSize > PREFETCH_BUFFER_SIZE || alignedSize > frameSlotCapacity()) {
+    return false;
+  }
+
+#if HAVE_ASYNC_MEMCPY
+  if (asyncCopy && ((uintptr_t)slot->data % FRAME_SLOT_ALIGN) == 0) {
+#if CONFIG_IDF_TARGET_ESP32S3
+    // GDMA reads PSRAM directly, so flush what the network task wrote via cache
+    Cache_WriteBack_Addr((uint32_t)(uintptr_t)slot->data, alignedSize);
+#endif
+    if (esp_async_memcpy(asyncCopy, staging[buffer], slot->data, alignedSize,
+                         onCopyDone, nullptr) == ESP_OK) {
+      return true;
+    }
+  }
+#endif
+  memcpy(staging[buffer], slot->data, size);
+  xSemaphoreGive(copyDone);
+  return true;
+}
+
+// Copy the oldest ready frame while the current one decodes
+static void startPrefetch() {
+  uint32_t generation;
+  FrameSlot* slot = peekFrameSlot(&generation);
+  if (!slot || !startCopy(slot, pendingBuffer)) return;
+  pendingSlot = slot;
+  pendingGeneration = generation;
+}
+
+// Wait for the prefetch copy; true if it holds this frame and the receiver
+// did not recycle the slot while it was copied
+static bool takePrefetched(FrameSlot* slot) {
+  if (!pendingSlot) return false;
+  xSemaphoreTake(copyDone, portMAX_DELAY);
+  bool staged = slot == pendingSlot && slot->generation == pendingGeneration;
+  pendingSlot = nullptr;
+  return staged;
+}
+
+bool nextStagedFrame(StagedFrame* frame, TickType_t timeout) {
+  FrameSlot* slot = waitFrameSlot(timeout);
+  int buffer = pendingBuffer;
+  bool inSram = takePrefetched(slot);
+  if (!slot) return false;
+  if (!inSram && startCopy(slot, buffer)) {
+    xSemaphoreTake(copyDone, portMAX_DELAY);
+    inSram = true;
+  }
+
+  frame->size = slot->size;
+  frame->seq = slot->seq;
+  frame->tiled = slot->tiled;
+  frame->readyUs = slot->readyUs;
+  frame->inSram = inSram;
+
+  if (inSram) {
+    frame->data = staging[buffer];
+    frame->slot = nullptr;
+    releaseFrameSlot(slot);  // The PSRAM copy is no longer needed
+  } else {
+    frame->data = slot->data;
+    frame->slot = slot;
+  }
+
+  pendingBuffer = buffer ^ 1;
+  startPrefetch();
+  return true;
+}
+
+void finishStagedFrame(StagedFrame* frame) {
+  if (frame->slot) {
+    releaseFrameSlot(frame->slot);
+    frame->slot = nullptr;
+  }
+}
+
+// Forget a frame being prefetched (e.g. after the client disconnected);
+// it is still in the ready queue, which the receiver flushes
+void dropStagedFrames() {
+  if (!pendingSlot) return;
+  xSemaphoreTake(copyDone, portMAX_DELAY);
+  pendingSlot = nullptr;
+}
@@ -0,0 +1,149 @@
+#include "frame_queue.h"
+#include <esp_heap_caps.h>
+
+static FrameSlot primarySlots[FRAME_SLOTS];
+static FramePool primary;
+
+// Slot size should be a multiple of FRAME_SLOT_ALIGN
+bool allocateFramePool(FramePool* pool, FrameSlot* slots, int count, size_t slotSize,
+                       bool internalFallback) {
+  pool->freeQueue = xQueueCreate(count, sizeof(FrameSlot*));
+  pool->readyQueue = xQueueCreate(count, sizeof(FrameSlot*));
+  if (!pool->freeQueue || !pool->readyQueue) {
+    Serial.println("Failed to create frame queues");
+    return false;
+  }
+
+  for (int i = 0; i < count; i++) {
+    slots[i].data = (uint8_t*)heap_caps_aligned_alloc(FRAME_SLOT_ALIGN, slotSize, MALLOC_CAP_SPIRAM);
+    if (!slots[i].data && internalFallback) {
+      slots[i].data = (uint8_t*)malloc(slotSize);
+    }
+    if (!slots[i].data) {
+      Serial.printf("Failed to allocate frame slot %d\n", i);
+      for (int j = 0; j < i; j++) {
+        free(slots[j].data);
+        slots[j].data = nullptr;
+      }
+      return false;
+    }
+    slots[i].size = 0;
+    FrameSlot* slot = &slots[i];
+    xQueueSend(pool->freeQueue, &slot, 0);
+  }
+  pool->slots = slots;
+  pool->count = count;
+  pool->capacity = slotSize;
+  pool->dropped = 0;
+  return true;
+}
+
+static bool dropHolder(FrameSlot* slot) {
+  return __atomic_sub_fetch(&slot->holders, 1, __ATOMIC_ACQ_REL) == 0;
+}
+
+// Get an empty slot for receiving. If none is free, the oldest frame that is
+// still waiting for the decoder is dropped and reused.
+FrameSlot* acquirePoolSlot(FramePool* pool) {
+  FrameSlot* slot = nullptr;
+  for (;;) {
+    if (xQueueReceive(pool->freeQueue, &slot, 0) == pdTRUE) break;
+    if (xQueueReceive(pool->readyQueue, &slot, 0) == pdTRUE) {
+      pool->dropped++;
+      if (dropHolder(slot)) break;
+      continue;  // A relay is still forwarding it and frees it when done
+    }
+    // Decoder holds the remaining slot - wait until it is released
+    xQueueReceive(pool->freeQueue, &slot, portMAX_DELAY);
+    break;
+  }
+  slot->size = 0;
+  slot->holders = 1;
+  slot->generation++;
+  return slot;
+}
+
+void submitPoolSlot(FramePool* pool, FrameSlot* slot) {
+  slot->readyUs = micros();
+  xQueueSend(pool->readyQueue, &slot, portMAX_DELAY);
+}
+
+FrameSlot* takePoolSlot(FramePool* pool, TickType_t timeout) {
+  FrameSlot* slot = nullptr;
+  if (xQueueReceive(pool->readyQueue, &slot, timeout) != pdTRUE) {
+    return nullptr;
+  }
+  return slot;
+}
+
+void releasePoolSlot(FramePool* pool, FrameSlot* slot) {
+  if (!dropHolder(slot)) return;
+  slot->size = 0;
+  xQueueSend(pool->freeQueue, &slot, portMAX_DELAY);
+}
+
+// Return all frames waiting for decode to the free list
+void flushFramePool(FramePool* pool) {
+  FrameSlot* slot = nullptr;
+  while (xQueueReceive(pool->readyQueue, &slot, 0) == pdTRUE) {
+    releasePoolSlot(pool, slot);
+  }
+}
+
+// Allocate the primary frame slots in PSRAM (falls back to internal RAM)
+bool allocateFrameQueue(size_t slotSize) {
+  if (!allocateFramePool(&primary, primarySlots, FRAME_SLOTS, slotSize, true)) return false;
+  Serial.printf("Frame slots allocated: %d x %dKB\n", FRAME_SLOTS, slotSize / 1024);
+  return true;
+}
+
+size_t frameSlotCapacity() {
+  return primary.capacity;
+}
+
+FramePool* frameQueuePool() {
+  return &primary;
+}
+
+FrameSlot* acquireFrameSlot() {
+  return acquirePoolSlot(&primary);
+}
+
+void submitFrameSlot(FrameSlot* slot) {
+  submitPoolSlot(&primary, slot);
+}
+
+FrameSlot* waitFrameSlot(TickType_t timeout) {
+  return takePoolSlot(&primary, timeout);
+}
+
+FrameSlot* peekFrameSlot(uint32_t* generation) {
+  FrameSlot* slot = nullptr;
+  if (xQueuePeek(primary.readyQueue, &slot, 0) != pdTRUE) return nullptr;
+  *generation = slot->generation;
+  // The slot may have been recycled before its generation was read; then
+  // it is only ready again once it holds the new frame
+  FrameSlot* head = nullptr;
+  if (xQueuePeek(primary.readyQueue, &head, 0) != pdTRUE || head != slot) return nullptr;
+  return slot;
+}
+
+void holdFrameSlot(FrameSlot* slot) {
+  __atomic_add_fetch(&slot->holders, 1, __ATOMIC_ACQ_REL);
+}
+
+void releaseFrameSlot(FrameSlot* slot) {
+  releasePoolSlot(&primary, slot);
+}
+
+void flushFrameQueue() {
+  flushFramePool(&primary);
+}
+
+uint32_t frameQueueDepth() {
+  return uxQueueMessagesWaiting(primary.readyQueue);
+}
+
+uint32_t framesDropped() {
+  return primary.dropped;
+}
@@ -0,0 +1,312 @@
+#include "frame_relay.h"
+#include "stream_protocol.h"
+#include "stream_receiver.h"
+#include <WiFi.h>
+#include <lwip/sockets.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+
+// Next to the receive tasks on core 0, one priority below them so receiving
+// always comes before forwarding
+#define RELAY_TASK_CORE          0
+#define RELAY_TASK_PRIORITY      2
+#define RELAY_TASK_STACK         3072
+#define RELAY_CONNECT_TIMEOUT_MS 1000
+#define RELAY_RETRY_MS           1000
+#define RELAY_SEND_TIMEOUT_S     1
+#define RELAY_ENTRY_SIZE         6
+#define ACK_RING                 8
+#define RELAY_REFRESH_MS         1000
+
+struct Downstream {
+  // Written by relayConfigure under configLock
+  uint8_t ip[4];
+  uint16_t port;       // 0 = no downstream in this position
+  uint8_t node;
+  volatile uint32_t generation;
+
+  // Owned by the downstream task
+  WiFiClient client;
+  QueueHandle_t pending;
+  uint32_t connectedGeneration;
+  unsigned long lastAttempt;
+  uint32_t seq;        // Frames sent on this connection, as counted downstream
+  uint32_t ackedSeq;
+  unsigned long sentUs[ACK_RING];
+  uint8_t rxHeader[MUX_HEADER_SIZE];
+  size_t rxHeaderLen;
+  size_t rxRemaining;
+  uint8_t rxMessage[MUX_MAX_MESSAGE];
+  size_t rxMessageLen;
+
+  volatile bool connected;
+  volatile bool busy;  // Sending a frame right now
+
+  // Cumulative, read by printRelayStats()
+  volatile uint32_t framesSent;
+  volatile uint32_t framesDropped;
+  volatile uint32_t sendUs;
+  volatile uint32_t hopUs;
+  volatile uint32_t acks;
+  uint32_t reported[5];
+};
+
+static Downstream downstreams[RELAY_MAX_DOWNSTREAM];
+static SemaphoreHandle_t configLock = nullptr;
+static uint8_t relayMessage[MUX_MAX_MESSAGE];  // Passed on with the node index replaced
+static size_t relayMessageLen = 0;
+
+// Tiles a hop misses only come back with a refresh from the sender, which
+// redraws every screen in the tree. Asking on every dropped frame would do
+// that at the slow hop's frame rate and load it even more, so requests are
+// coalesced into at most one per RELAY_REFRESH_MS.
+static volatile bool refreshWanted = false;
+static unsigned long lastRefreshMs = 0;
+
+static void flushRefresh() {
+  if (!refreshWanted) return;
+  xSemaphoreTake(configLock, portMAX_DELAY);
+  bool send = refreshWanted && millis() - lastRefreshMs >= RELAY_REFRESH_MS;
+  if (send) {
+    refreshWanted = false;
+    lastRefreshMs = millis();
+  }
+  xSemaphoreGive(configLock);
+  if (send) requestRefresh();
+}
+
+static void dropFrame(Downstream* d, FrameSlot* slot) {
+  d->framesDropped++;
+  if (slot->tiled) refreshWanted = true;  // The downstream misses these tiles
+  releaseFrameSlot(slot);
+}
+
+static void drainPending(Downstream* d) {
+  FrameSlot* slot = nullptr;
+  while (xQueueReceive(d->pending, &slot, 0) == pdTRUE) {
+    releaseFrameSlot(slot);
+  }
+}
+
+static void disconnect(Downstream* d, const char* reason) {
+  Serial.printf("Relay: node %u %s\n", d->node, reason);
+  d->connected = false;
+  d->client.stop();
+  drainPending(d);
+}
+
+// Connect (or reconnect after a new configuration) and pass the relay list on
+static bool ensureConnected(Downstream* d) {
+  uint32_t generation = d->generation;
+  if (d->connected) {
+    if (generation == d->connectedGeneration && d->client.connected()) return true;
+    disconnect(d, generation != d->connectedGeneration ? "reconfigured" : "disconnected");
+  }
+  if (millis() - d->lastAttempt < RELAY_RETRY_MS) return false;
+  d->lastAttempt = millis();
+
+  uint8_t hello[MUX_MAGIC_LEN + MUX_HEADER_SIZE + MUX_MAX_MESSAGE];
+  xSemaphoreTake(configLock, portMAX_DELAY);
+  IPAddress ip(d->ip[0], d->ip[1], d->ip[2], d->ip[3]);
+  uint16_t port = d->port;
+  memcpy(hello, MUX_MAGIC, MUX_MAGIC_LEN);
+  hello[MUX_MAGIC_LEN] = MUX_CH_CONTROL;
+  hello[MUX_MAGIC_LEN + 1] = 0;
+  putLE16(hello + MUX_MAGIC_LEN + 2, relayMessageLen);
+  memcpy(hello + MUX_MAGIC_LEN + MUX_HEADER_SIZE, relayMessage, relayMessageLen);
+  hello[MUX_MAGIC_LEN + MUX_HEADER_SIZE + 2] = d->node;
+  size_t helloLen = MUX_MAGIC_LEN + MUX_HEADER_SIZE + relayMessageLen;
+  xSemaphoreGive(configLock);
+  if (port == 0) return false;
+
+  if (!d->client.connect(ip, port, RELAY_CONNECT_TIMEOUT_MS)) return false;
+  d->client.setNoDelay(true);
+  // A downstream that stops reading fails the send instead of stalling the relay
+  struct timeval timeout = {RELAY_SEND_TIMEOUT_S, 0};
+  setsockopt(d->client.fd(), SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+  if (d->client.write(hello, helloLen) != helloLen) {
+    d->client.stop();
+    return false;
+  }
+  d->seq = 0;
+  d->ackedSeq = 0;
+  d->rxHeaderLen = 0;
+  d->connectedGeneration = generation;
+  d->connected = true;
+  Serial.printf("Relay: forwarding to node %u at %s:%u\n", d->node, ip.toString().c_str(), port);
+  return true;
+}
+
+// Each chunk goes out as one write of the packet header and the payload,
+// which is read straight from the frame slot
+static bool sendFrame(Downstream* d, FrameSlot* slot) {
+  unsigned long start = micros();
+  uint32_t seq = ++d->seq;
+  d->sentUs[seq % ACK_RING] = start;
+  int fd = d->client.fd();
+  size_t pos = 0;
+  while (pos < slot->size) {
+    size_t n = min(slot->size - pos, (size_t)MUX_VIDEO_CHUNK);
+    uint8_t header[MUX_HEADER_SIZE];
+    header[0] = MUX_CH_VIDEO;
+    header[1] = (pos == 0 ? MUX_FLAG_FRAME_START | (slot->tiled ? MUX_FLAG_TILED : 0) : 0) |
+                (pos + n == slot->size ? MUX_FLAG_FRAME_END : 0);
+    putLE16(header + 2, n);
+    struct iovec iov[2] = {{header, MUX_HEADER_SIZE}, {slot->data + pos, n}};
+    if (writev(fd, iov, 2) != (ssize_t)(MUX_HEADER_SIZE + n)) return false;
+    pos += n;
+  }
+  d->sendUs += micros() - start;
+  d->framesSent++;
+  return true;
+}
+
+static void handleDownstreamMessage(Downstream* d, uint8_t channel, const uint8_t* msg, size_t len) {
+  if (len == 0) return;
+  if (channel == MUX_CH_CONTROL && msg[0] == CTRL_REFRESH) {
+    refreshWanted = true;  // Tiles come from the sender, so ask it
+  } else if (channel == MUX_CH_TELEMETRY && msg[0] == TELEM_FRAME_ACK && len >= 17) {
+    // Hop latency: from the first byte sent until the downstream had the
+    // whole frame, plus the ack's way back
+    uint32_t seq = getLE32(msg + 1);
+    uint32_t queueUs = getLE32(msg + 9);
+    uint32_t decodeUs = getLE32(msg + 13);
+    if (d->seq - seq >= ACK_RING) return;
+    uint32_t totalUs = micros() - d->sentUs[seq % ACK_RING];
+    if (totalUs > queueUs + decodeUs) d->hopUs += totalUs - queueUs - decodeUs;
+    d->acks++;
+    d->ackedSeq = seq;
+  }
+}
+
+// Acks and refresh requests coming back from the downstream
+static void readUpstream(Downstream* d) {
+  uint8_t buf[128];
+  int available;
+  while ((available = d->client.available()) > 0) {
+    int n = d->client.read(buf, min(available, (int)sizeof(buf)));
+    if (n <= 0) return;
+    for (int i = 0; i < n; i++) {
+      if (d->rxHeaderLen < MUX_HEADER_SIZE) {
+        d->rxHeader[d->rxHeaderLen++] = buf[i];
+        if (d->rxHeaderLen == MUX_HEADER_SIZE) {
+          d->rxRemaining = getLE16(d->rxHeader + 2);
+          d->rxMessageLen = 0;
+          if (d->rxRemaining == 0) d->rxHeaderLen = 0;
+        }
+        continue;
+      }
+      if (d->rxMessageLen < MUX_MAX_MESSAGE) d->rxMessage[d->rxMessageLen++] = buf[i];
+      if (--d->rxRemaining == 0) {
+        handleDownstreamMessage(d, d->rxHeader[0], d->rxMessage, d->rxMessageLen);
+        d->rxHeaderLen = 0;
+      }
+    }
+  }
+}
+
+static void relayTask(void* arg) {
+  Downstream* d = (Downstream*)arg;
+  for (;;) {
+    if (!ensureConnected(d)) {
+      drainPending(d);
+      vTaskDelay(pdMS_TO_TICKS(100));
+      continue;
+    }
+    // Poll quickly while an ack is due so the hop time is not inflated
+    TickType_t wait = d->ackedSeq != d->seq ? 1 : pdMS_TO_TICKS(10);
+    FrameSlot* slot = nullptr;
+    if (xQueueReceive(d->pending, &slot, wait) == pdTRUE) {
+      d->busy = true;
+      bool sent = sendFrame(d, slot);
+      d->busy = false;
+      releaseFrameSlot(slot);
+      if (!sent) {
+        disconnect(d, "send failed");
+        continue;
+      }
+    }
+    readUpstream(d);
+    flushRefresh();
+  }
+}
+
+void relayConfigure(const uint8_t* msg, size_t len) {
+  if (len < 4) return;
+  uint8_t fanout = msg[1];
+  uint8_t node = msg[2];
+  uint8_t count = msg[3];
+  if (fanout < 1 || fanout > RELAY_MAX_DOWNSTREAM || count > RELAY_MAX_NODES ||
+      len < 4 + (size_t)count * RELAY_ENTRY_SIZE) {
+    Serial.println("Relay: invalid configuration");
+    return;
+  }
+  if (!configLock) configLock = xSemaphoreCreateMutex();
+
+  xSemaphoreTake(configLock, portMAX_DELAY);
+  relayMessageLen = 4 + count * RELAY_ENTRY_SIZE;
+  memcpy(relayMessage, msg, relayMessageLen);
+  for (int i = 0; i < RELAY_MAX_DOWNSTREAM; i++) {
+    Downstream* d = &downstreams[i];
+    uint32_t child = (uint32_t)node * fanout + 1 + i;
+    if (i < fanout && child <= count) {
+      const uint8_t* entry = msg + 4 + (child - 1) * RELAY_ENTRY_SIZE;
+      memcpy(d->ip, entry, 4);
+      d->port = getLE16(entry + 4);
+      d->node = child;
+    } else {
+      d->port = 0;
+    }
+    d->generation++;
+  }
+  xSemaphoreGive(configLock);
+
+  Serial.printf("Relay: node %u of %u, fan-out %u\n", node, count + 1, fanout);
+  for (int i = 0; i < RELAY_MAX_DOWNSTREAM; i++) {
+    Downstream* d = &downstreams[i];
+    if (d->port == 0 || d->pending) continue;
+    d->pending = xQueueCreate(1, sizeof(FrameSlot*));
+    if (!d->pending || xTaskCreatePinnedToCore(relayTask, "relay_tx", RELAY_TASK_STACK, d,
+                                               RELAY_TASK_PRIORITY, nullptr, RELAY_TASK_CORE) != pdPASS) {
+      Serial.println("Relay: failed to start forwarding task");
+    }
+  }
+}
+
+// Never blocks: a downstream still sending the previous frame skips this one,
+// and one that has not picked up the waiting frame yet gets this one instead
+void relayFrame(FrameSlot* slot) {
+  for (int i = 0; i < RELAY_MAX_DOWNSTREAM; i++) {
+    Downstream* d = &downstreams[i];
+    if (!d->pending || !d->connected) continue;
+    holdFrameSlot(slot);
+    if (d->busy) {
+      dropFrame(d, slot);
+      continue;
+    }
+    FrameSlot* waiting = nullptr;
+    if (xQueueReceive(d->pending, &waiting, 0) == pdTRUE) dropFrame(d, waiting);
+    if (xQueueSend(d->pending, &slot, 0) != pdTRUE) dropFrame(d, slot);
+  }
+}
+
+void printRelayStats() {
+  for (int i = 0; i < RELAY_MAX_DOWNSTREAM; i++) {
+    Downstream* d = &downstreams[i];
+    if (!d->pending || d->port == 0) continue;
+    if (!d->connected) {
+      Serial.printf("Relay -> node %u: not connected\n", d->node);
+      continue;
+    }
+    uint32_t now[5] = {d->framesSent, d->framesDropped, d->sendUs, d->hopUs, d->acks};
+    uint32_t sent = now[0] - d->reported[0];
+    uint32_t acks = now[4] - d->reported[4];
+    Serial.printf("Relay -> node %u: %u sent, %u dropped | send %.1fms | hop %.1fms\n",
+                  d->node, sent, now[1] - d->reported[1],
+                  sent ? (now[2] - d->reported[2]) / 1000.0f / sent : 0,
+                  acks ? (now[3] - d->reported[3]) / 1000.0f / acks : 0);
+    memcpy(d->reported, now, sizeof(now));
+  }
+}
@@ -0,0 +1,128 @@
+#include "inset_stream.h"
+#include "coop_scheduler.h"
+#include "mjpeg_scanner.h"
+#include "stream_receiver.h"
+#include <WiFi.h>
+#include <WiFiServer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+// Same core and priority as the primary network task
+#define INSET_TASK_CORE      0
+#define INSET_TASK_PRIORITY  3
+#define INSET_TASK_STACK     3072
+#define INSET_SLOTS          3
+#define INSET_SLOT_SIZE      (48 * 1024)
+#define ACCEPT_INTERVAL_MS   50
+
+static WiFiServer server(INSET_PORT);
+static WiFiClient client;
+
+static FrameSlot slots[INSET_SLOTS];
+static FramePool pool;
+
+static volatile bool connected = false;
+static volatile uint32_t bytesReceived = 0;
+
+static FrameSlot* rxSlot = nullptr;
+static uint32_t rxSeq = 0;
+
+// Frames are delimited by SOI and EOI like the primary raw stream
+static void insetFrame(FrameSlot* frame) {
+  frame->seq = ++rxSeq;
+  submitPoolSlot(&pool, frame);
+}
+
+static MjpegScanner scanner = {&pool, insetFrame, 0};
+
+static void onDisconnect() {
+  Serial.println("Inset client disconnected");
+  connected = false;
+  flushFramePool(&pool);
+  if (rxSlot) rxSlot->size = 0;
+}
+
+static bool serviceInset() {
+  if (!client || !client.connected()) {
+    if (connected) onDisconnect();
+    static unsigned long lastAccept = 0;
+    if (!acceptStreamClient(server, client, &lastAccept, ACCEPT_INTERVAL_MS)) return false;
+    Serial.println("Inset client connected");
+    client.setNoDelay(true);
+    rxSeq = 0;
+    mjpegScanReset(&scanner);
+    if (!rxSlot) rxSlot = acquirePoolSlot(&pool);
+    connected = true;
+  }
+
+  int available = client.available();
+  if (available <= 0) return false;
+  size_t space = INSET_SLOT_SIZE - rxSlot->size;
+  int bytesRead = client.read(rxSlot->data + rxSlot->size, min((size_t)available, space));
+  if (bytesRead <= 0) return false;
+  rxSlot->size += bytesRead;
+  bytesReceived += bytesRead;
+  rxSlot = mjpegScan(&scanner, rxSlot);
+  return true;
+}
+
+static void insetTask(void* arg) {
+  for (;;) {
+    if (!serviceInset()) {
+      vTaskDelay(1);
+    }
+  }
+}
+
+bool beginInsetStream() {
+  if (!allocateFramePool(&pool, slots, INSET_SLOTS, INSET_SLOT_SIZE, false)) {
+    Serial.println("No PSRAM for the inset stream");
+    return false;
+  }
+
+  server.begin();
+  server.setNoDelay(true);
+  Serial.printf("Inset server listening on port %d\n", INSET_PORT);
+
+#if STREAM_COOPERATIVE
+  return true;
+#else
+  return xTaskCreatePinnedToCore(insetTask, "inset_rx", INSET_TASK_STACK, nullptr,
+                                 INSET_TASK_PRIORITY, nullptr, INSET_TASK_CORE) == pdPASS;
+#endif
+}
+
+bool pollInsetStream() {
+  return serviceInset();
+}
+
+bool insetConnected() {
+  return connected;
+}
+
+FrameSlot* takeInsetFrame() {
+  if (!pool.readyQueue) return nullptr;
+  FrameSlot* slot = takePoolSlot(&pool, 0);
+  if (!slot) return nullptr;
+
+  // Only the newest frame is worth decoding
+  FrameSlot* newer = nullptr;
+  while ((newer = takePoolSlot(&pool, 0)) != nullptr) {
+    releaseInsetFrame(slot);
+    pool.dropped++;
+    slot = newer;
+  }
+  return slot;
+}
+
+void releaseInsetFrame(FrameSlot* slot) {
+  releasePoolSlot(&pool, slot);
+}
+
+uint32_t insetBytesReceived() {
+  return bytesReceived;
+}
+
+uint32_t insetFramesDropped() {
+  return pool.dropped;
+}
@@ -0,0 +1,37 @@
+#include "latency_histogram.h"
+
+static int bucketFor(uint32_t us) {
+  if (us < 4) return us;
+  int msb = 31 - __builtin_clz(us);
+  int sub = (us >> (msb - 2)) & 3;
+  return min((msb - 1) * 4 + sub, LATENCY_BUCKETS - 1);
+}
+
+// Midpoint of a bucket's range
+static uint32_t bucketValue(int bucket) {
+  if (bucket < 4) return bucket;
+  int msb = bucket / 4 + 1;
+  uint32_t low = (1u << msb) | ((uint32_t)(bucket % 4) << (msb - 2));
+  return msb < 3 ? low : low + (1u << (msb - 3));
+}
+
+void latencyReset(LatencyHistogram* hist) {
+  memset(hist, 0, sizeof(LatencyHistogram));
+}
+
+void latencyRecord(LatencyHistogram* hist, uint32_t us) {
+  int bucket = bucketFor(us);
+  if (hist->counts[bucket] < UINT16_MAX) hist->counts[bucket]++;
+  hist->total++;
+}
+
+uint32_t latencyPercentile(const LatencyHistogram* hist, uint8_t percent) {
+  if (hist->total == 0) return 0;
+  uint32_t rank = ((uint64_t)hist->total * percent + 99) / 100;
+  uint32_t seen = 0;
+  for (int i = 0; i < LATENCY_BUCKETS; i++) {
+    seen += hist->counts[i];
+    if (seen >= rank) return bucketValue(i);
+  }
+  return bucketValue(LATENCY_BUCKETS - 1);
+}
@@ -7,10 +7,20 @@
  * - Reads WiFi credentials from Keira's NVS storage (namespace "kwifi")
  * - Uses the same SSID hashing scheme as Keira for password retrieval
  * - No interactive WiFi configuration - credentials must be set in Keira first
+ * - Joins the AP of any network saved in Keira with the best expected
+ *   throughput, and roams when the stream slows down on a weak link
+ * - Without Keira credentials, or with C held at startup, the Lilka starts its
+ *   own access point instead (direct link, see wifi_config.h) and shows the
+ *   SSID and password on the waiting screen
  * 
- * Protocol: Raw MJPEG stream
- *   Frames are detected by JPEG SOI (0xFFD8) and EOI (0xFFD9) markers
+ * Protocol: Raw MJPEG stream or multiplexed channels (see stream_protocol.h)
+ *   Raw frames are detected by JPEG SOI (0xFFD8) and EOI (0xFFD9) markers
  *   Compatible with GStreamer jpegenc output via tcpclientsink
+ *   Multiplexed streams (host/lilka_sender.py) interleave chunked video with
+ *   prioritised control, cursor, input and telemetry messages, and may carry
+ *   tiled frames mixing JPEG, palette/RLE and raw RGB565 tiles
+ *   Frame size may change on any frame: smaller frames are upscaled 2x and
+ *   letterboxed (see frame_layout.h)
  *
  * GStreamer pipeline example:
  *   gst-launch-1.0 ximagesrc ! videoscale ! video/x-raw,width=280,height=240 \
@@ -19,143 +29,111 @@
  *
  * Performance optimizations:
  * - TJpgDec library for efficient JPEG decoding on ESP32
- * - PSRAM buffer for JPEG data (supports frames up to ~100KB)
- * - Direct RGB565 output to display
+ * - PSRAM frame slots for JPEG data (supports frames up to ~100KB)
+ * - Network task on core 0 receives while core 1 decodes; single-core chips
+ *   interleave socket reads between MCU rows instead (coop_scheduler.h)
+ * - Next frame is prefetched from PSRAM into internal SRAM by GDMA while the
+ *   current one decodes, so TJpgDec reads from fast memory
+ * - The last seconds of JPEG frames stay in a PSRAM ring for pause, step and
+ *   replay (see frame_history.h)
+ * - A second raw MJPEG stream on port 8091 is decoded at 1/2 or 1/4 scale into
+ *   a corner inset; primary blocks under it are not pushed (inset_stream.h)
+ * - Decoded blocks are collected per MCU row and pushed under one address
+ *   window, instead of one window and RAM write per 16x16 block
+ * - Direct RGB565 output to display; the stats overlay (button D) is blended
+ *   into the same blocks instead of being drawn on top (see osd.h)
  * - TCP with no-delay for low latency streaming
+ *
+ * Hold B at startup (or press it on the waiting screen) for a self-benchmark
+ * on an embedded JPEG corpus, comparable across units and builds
+ * (self_benchmark.h)
  */
 
 #include <Arduino.h>
 #include <lilka.h>
 #include <WiFi.h>
-#include <WiFiServer.h>
 #include <esp_heap_caps.h>
 #include <TJpg_Decoder.h>
 #include "wifi_config.h"
+#include "frame_queue.h"
+#include "frame_prefetch.h"
+#include "stream_receiver.h"
+#include "tile_decoder.h"
+#include "latency_histogram.h"
+#include "frame_layout.h"
+#include "coop_scheduler.h"
+#include "osd.h"
+#include "frame_history.h"
+#include "inset_stream.h"
+#include "rtp_receiver.h"
+#include "frame_relay.h"
+#include "display_calibration.h"
+#include "self_benchmark.h"
+#include "hot_path.h"
 
-// Display dimensions
-#define DISPLAY_WIDTH  280
-#define DISPLAY_HEIGHT 240
-
-// Network settings
-WiFiServer server(8090);
-WiFiClient client;
-
-// JPEG markers
-const uint8_t JPEG_SOI[2] = {0xFF, 0xD8};  // Start of Image
-const uint8_t JPEG_EOI[2] = {0xFF, 0xD9};  // End of Image
-
-// JPEG buffer (allocate in PSRAM for larger frames)
+// JPEG frame slots (allocated in PSRAM for larger frames)
+#if STREAM_COOPERATIVE
+const size_t MAX_JPEG_SIZE = 32 * 1024;   // Single-core chips have no PSRAM
+#else
 const size_t MAX_JPEG_SIZE = 100 * 1024;  // 100KB max frame size
-uint8_t* jpegBuffer = nullptr;
-size_t jpegBufferPos = 0;
-
-// Ring buffer for incoming data
-const size_t RECV_BUFFER_SIZE = 32 * 1024;
-uint8_t* recvBuffer = nullptr;
-size_t recvBufferPos = 0;
+#endif
 
 // Stats
 unsigned long frameCount = 0;
 unsigned long lastStats = 0;
 uint32_t frameId = 0;
-unsigned long totalBytesReceived = 0;
-unsigned long decodeTimeMs = 0;
+uint32_t lastBytesReceived = 0;
+uint32_t lastFramesDropped = 0;
+unsigned long decodeTimeUs = 0;
+unsigned long sramDecodeUs = 0;
+unsigned long psramDecodeUs = 0;
+uint32_t sramFrames = 0;
+uint32_t psramFrames = 0;
+LatencyHistogram statsHistogram;  // Decode times over the stats window
+bool wasConnected = false;
+uint16_t localButtons = 0;  // Pressed with Select; their releases stay local too
 
-// TJpgDec callback - outputs directly to display using Arduino_GFX method
-bool tjpgd_output(int16_t x, int16_t y, uint16_t w, uint16_t h, uint16_t* bitmap) {
-  // Clip to display bounds
-  if (x >= DISPLAY_WIDTH || y >= DISPLAY_HEIGHT) return true;
-  
-  uint16_t drawW = w;
-  uint16_t drawH = h;
-  
-  if (x + w > DISPLAY_WIDTH) drawW = DISPLAY_WIDTH - x;
-  if (y + h > DISPLAY_HEIGHT) drawH = DISPLAY_HEIGHT - y;
-  
-  // Use Arduino_GFX fast bitmap drawing
-  lilka::display.draw16bitRGBBitmap(x, y, bitmap, drawW, drawH);
-  
-  return true;  // Continue decoding
-}
+// Picture-in-picture inset stream
+unsigned long insetFrameCount = 0;
+unsigned long insetDecodeUs = 0;
+uint32_t lastInsetDropped = 0;
+uint32_t lastRtpLost = 0;
+bool insetWasConnected = false;
+bool insetTurn = false;  // Round-robin between the streams
 
-// Allocate buffers in PSRAM
-bool allocateBuffers() {
-  // Allocate JPEG receive buffer
-  jpegBuffer = (uint8_t*)ps_malloc(MAX_JPEG_SIZE);
-  if (!jpegBuffer) {
-    jpegBuffer = (uint8_t*)malloc(MAX_JPEG_SIZE);
-  }
-  if (!jpegBuffer) {
-    Serial.println("Failed to allocate JPEG buffer");
-    return false;
-  }
-  
-  // Allocate receive buffer
-  recvBuffer = (uint8_t*)ps_malloc(RECV_BUFFER_SIZE);
-  if (!recvBuffer) {
-    recvBuffer = (uint8_t*)malloc(RECV_BUFFER_SIZE);
-  }
-  if (!recvBuffer) {
-    Serial.println("Failed to allocate receive buffer");
-    free(jpegBuffer);
-    jpegBuffer = nullptr;
-    return false;
-  }
-  
-  Serial.printf("Buffers allocated: JPEG=%dKB, Recv=%dKB\n", 
-                MAX_JPEG_SIZE / 1024, 
-                RECV_BUFFER_SIZE / 1024);
-  
-  return true;
-}
+// Telemetry window (sent to the sender every second)
+const unsigned long TELEMETRY_INTERVAL_MS = 1000;
+unsigned long lastTelemetry = 0;
+uint32_t telemetryFrames = 0;
+uint32_t telemetryBytes = 0;
+uint32_t framesDecoded = 0;
+uint32_t telemetryDropped = 0;
+LatencyHistogram decodeHistogram;
 
-bool readExactly(WiFiClient& c, uint8_t* dst, size_t len) {
-  size_t got = 0;
-  unsigned long startTime = millis();
-  const unsigned long timeout = 5000;  // 5 second timeout
-  
-  while (got < len && c.connected()) {
-    if (millis() - startTime > timeout) {
-      Serial.printf("Read timeout: got %d/%d bytes\n", got, len);
-      return false;
-    }
-    
-    int available = c.available();
-    if (available > 0) {
-      int toRead = min((size_t)available, len - got);
-      int chunk = c.read(dst + got, toRead);
-      if (chunk > 0) {
-        got += chunk;
-        startTime = millis();  // Reset timeout on successful read
-      }
-    } else {
-      delay(1);  // Allow other tasks
-    }
-  }
-  return got == len;
+bool decodeStep();
+
+// Bytes of the primary stream, over TCP or RTP
+uint32_t bytesReceived() {
+  return streamBytesReceived() + rtpBytesReceived();
 }
 
-// Find JPEG frame in buffer, returns frame size or 0 if not found
-size_t findJpegFrame(uint8_t* buffer, size_t len, size_t* frameStart) {
-  // Look for SOI marker (0xFFD8)
-  for (size_t i = 0; i < len - 1; i++) {
-    if (buffer[i] == 0xFF && buffer[i + 1] == 0xD8) {
-      *frameStart = i;
-      // Look for EOI marker (0xFFD9)
-      for (size_t j = i + 2; j < len - 1; j++) {
-        if (buffer[j] == 0xFF && buffer[j + 1] == 0xD9) {
-          return j + 2 - i;  // Frame size including markers
-        }
-      }
-      return 0;  // SOI found but no EOI yet
-    }
+// TJpgDec callback - outputs directly to display, scaled to the frame layout
+bool HOT_IRAM tjpgd_output(int16_t x, int16_t y, uint16_t w, uint16_t h, uint16_t* bitmap) {
+#if STREAM_COOPERATIVE
+  // Let the receive step drain the socket once per MCU row
+  static int16_t lastRow = -1;
+  if (y != lastRow) {
+    lastRow = y;
+    coopYield();
   }
-  return 0;  // No SOI found
+#endif
+  return drawFrameBlock(x, y, w, h, bitmap);
 }
 
 // Display waiting screen with IP address and status message
 void showWaitingScreen() {
   lilka::display.fillScreen(lilka::colors::Black);
+  resetFrameLayout();
   int16_t x1, y1;
   uint16_t w, h;
   
@@ -169,7 +147,7 @@ void showWaitingScreen() {
   lilka::display.setCursor((lilka::display.width() - w) / 2, 100);
   lilka::display.println("IP Address:");
   
-  String ipStr = WiFi.localIP().toString();
+  String ipStr = linkIP().toString();
   lilka::display.setTextSize(1);
   lilka::display.setTextColor(lilka::colors::Green);
   lilka::display.getTextBounds(ipStr.c_str(), 0, 0, &x1, &y1, &w, &h);
@@ -177,9 +155,22 @@ void showWaitingScreen() {
   lilka::display.println(ipStr);
   
   lilka::display.setTextColor(lilka::colors::Cyan);
-  lilka::display.getTextBounds("Port: 8090", 0, 0, &x1, &y1, &w, &h);
+  lilka::display.getTextBounds("Port: 8090, RTP: 5004", 0, 0, &x1, &y1, &w, &h);
   lilka::display.setCursor((lilka::display.width() - w) / 2, 150);
-  lilka::display.println("Port: 8090");
+  lilka::display.println("Port: 8090, RTP: 5004");
+
+  if (directLinkActive()) {
+    // The sender joins this network first
+    String network = String("WiFi: ") + directLinkSSID();
+    String password = String("Password: ") + directLinkPassword();
+    lilka::display.setTextColor(lilka::colors::White);
+    lilka::display.getTextBounds(network.c_str(), 0, 0, &x1, &y1, &w, &h);
+    lilka::display.setCursor((lilka::display.width() - w) / 2, 170);
+    lilka::display.println(network);
+    lilka::display.getTextBounds(password.c_str(), 0, 0, &x1, &y1, &w, &h);
+    lilka::display.setCursor((lilka::display.width() - w) / 2, 185);
+    lilka::display.println(password);
+  }
   
   lilka::display.setTextSize(1);
   lilka::display.setTextColor(lilka::colors::Yellow);
@@ -191,17 +182,29 @@ void showWaitingScreen() {
 void setup() {
   // Initialize Lilka (display, buttons, SD card, etc.)
   lilka::begin();
+
+  // Hold A while the app starts to calibrate the display link
+  if (lilka::controller.getState().a.pressed) {
+    runDisplayCalibration();
+  }
+  applyDisplaySettings();
   lilka::display.fillScreen(lilka::colors::Black);
 
   Serial.println("MJPEG Stream Receiver starting...");
 
   // Initialize TJpgDec
-  TJpgDec.setJpgScale(1);  // No scaling - image should already be 280x240
+  TJpgDec.setJpgScale(1);  // No downscaling - smaller frames are upscaled in the callback
   TJpgDec.setSwapBytes(false);  // Don't swap bytes - Arduino_GFX handles byte order
   TJpgDec.setCallback(tjpgd_output);
+
+  // Hold B while the app starts to run the self-benchmark
+  if (lilka::controller.getState().b.pressed) {
+    runSelfBenchmark(tjpgd_output);
+    lilka::display.fillScreen(lilka::colors::Black);
+  }
   
-  // Allocate buffers
-  if (!allocateBuffers()) {
+  // Allocate frame slots
+  if (!allocateFrameQueue(MAX_JPEG_SIZE)) {
     lilka::Alert alert(
       "Memory Error",
       "Failed to allocate buffers.\n\nPSRAM may not be available.\n\nPress A to restart."
@@ -213,24 +216,29 @@ void setup() {
     ESP.restart();
   }
 
-  // Load WiFi credentials from Keira's NVS storage
+  // Load WiFi credentials from Keira's NVS storage; hold C (or configure
+  // nothing in Keira) for a direct link to the sender instead. This is C's
+  // only local use: while streaming it is just forwarded to the sender.
   String ssid, password;
-  if (!loadWiFiCredentials(ssid, password)) {
-    lilka::Alert alert(
-      "WiFi Error",
-      "No WiFi configured.\n\nPlease configure WiFi in Keira first.\n\nPress A to restart."
-    );
-    alert.draw(&lilka::display);
-    while (!alert.isFinished()) {
-      alert.update();
+  bool direct = lilka::controller.getState().c.pressed || !loadWiFiCredentials(ssid, password);
+  if (direct) {
+    if (!startDirectLink()) {
+      lilka::Alert alert(
+        "WiFi Error",
+        "Failed to start the direct link.\n\nConfigure WiFi in Keira instead.\n\nPress A to restart."
+      );
+      alert.draw(&lilka::display);
+      while (!alert.isFinished()) {
+        alert.update();
+      }
+      ESP.restart();
     }
-    ESP.restart();
+  } else {
+    Serial.printf("Found WiFi credentials for: %s\n", ssid.c_str());
   }
   
-  Serial.printf("Found WiFi credentials for: %s\n", ssid.c_str());
-  
   // Connect to WiFi
-  if (!connectToWiFi(ssid, password)) {
+  if (!direct && !connectToBestWiFi(ssid, password)) {
     lilka::Alert alert(
       "Connection Failed",
       "Failed to connect to WiFi.\n\nCheck credentials in Keira.\n\nPress A to restart."
@@ -244,109 +252,405 @@ void setup() {
 
   showWaitingScreen();
 
-  server.begin();
-  server.setNoDelay(true);
-  Serial.println("MJPEG server listening on port 8090");
+  beginFrameHistory();
+
+#if STREAM_COOPERATIVE
+  // Frames are already in internal RAM, so there is nothing to prefetch
+  coopAdd("rx", pollStreamReceiver);
+  coopAdd("decode", decodeStep);
+  Serial.println("Single-core mode: cooperative receive and decode");
+#else
+  if (!beginFramePrefetch()) {
+    Serial.println("Failed to set up frame prefetch");
+  }
+#endif
+
+  if (!beginStreamReceiver()) {
+    Serial.println("Failed to start stream receiver");
+  }
+
+  if (beginInsetStream()) {
+#if STREAM_COOPERATIVE
+    coopAdd("inset_rx", pollInsetStream);
+#endif
+  }
+
+  if (beginRtpReceiver()) {
+#if STREAM_COOPERATIVE
+    coopAdd("rtp_rx", pollRtpReceiver);
+#endif
+  } else {
+    Serial.println("Failed to start RTP receiver");
+  }
+}
+
+void resetStats() {
+  frameCount = 0;
+  decodeTimeUs = 0;
+  sramDecodeUs = psramDecodeUs = 0;
+  sramFrames = psramFrames = 0;
+  lastStats = millis();
+  lastBytesReceived = bytesReceived();
+  lastFramesDropped = framesDropped();
+  lastRtpLost = rtpFramesLost();
+  lastTelemetry = millis();
+  telemetryFrames = 0;
+  telemetryBytes = bytesReceived();
+  telemetryDropped = framesDropped();
+  latencyReset(&decodeHistogram);
 }
 
-bool handleClient() {
-  // Accept new client
-  if (!client || !client.connected()) {
-    client = server.available();
-    if (client) {
-      Serial.println("Client connected - MJPEG stream starting");
-      client.setNoDelay(true);
-      client.setTimeout(100);
-      frameCount = 0;
-      totalBytesReceived = 0;
-      decodeTimeMs = 0;
-      lastStats = millis();
-      jpegBufferPos = 0;
-    }
+// Decode a JPEG or tile container to the display
+JRESULT drawFrame(const uint8_t* data, size_t size, bool tiled, TileStats* tileStats) {
+  JRESULT res;
+  if (tiled) {
+    // Tiles are in display coordinates; after a scaled frame the unchanged
+    // tiles on screen no longer match, so ask for all of them
+    if (setFrameLayout(DISPLAY_WIDTH, DISPLAY_HEIGHT)) requestRefresh();
+    res = decodeTileFrame(data, size, tileStats);
+  } else {
+    uint16_t w, h;
+    if (jpegFrameSize(data, size, &w, &h)) setFrameLayout(w, h);
+    res = TJpgDec.drawJpg(0, 0, data, size);
   }
+  flushFrameBlocks();
+  osdFinishFrame();
+  return res;
+}
 
-  if (!client || !client.connected()) {
-    return false;
+// Decode one complete frame from the queue and report it to the sender
+void decodeFrame(StagedFrame* frame) {
+  unsigned long decodeStart = micros();
+  uint32_t queueUs = decodeStart - frame->readyUs;
+
+  TileStats tileStats;
+  JRESULT res = drawFrame(frame->data, frame->size, frame->tiled, &tileStats);
+
+  uint32_t decodeUs = micros() - decodeStart;
+  decodeTimeUs += decodeUs;
+  latencyRecord(&decodeHistogram, decodeUs);
+  latencyRecord(&statsHistogram, decodeUs);
+  if (frame->inSram) {
+    sramDecodeUs += decodeUs;
+    sramFrames++;
+  } else {
+    psramDecodeUs += decodeUs;
+    psramFrames++;
   }
 
-  // Read available data into JPEG buffer
-  int available = client.available();
-  if (available > 0) {
-    size_t toRead = min((size_t)available, MAX_JPEG_SIZE - jpegBufferPos);
-    if (toRead > 0) {
-      int bytesRead = client.read(jpegBuffer + jpegBufferPos, toRead);
-      if (bytesRead > 0) {
-        jpegBufferPos += bytesRead;
-        totalBytesReceived += bytesRead;
-      }
+  if (res != JDR_OK) {
+    Serial.printf("JPEG decode error: %d (frame size: %d)\n", res, frame->size);
+    if (frame->tiled) requestRefresh();
+  } else {
+    frameCount++;
+    frameId++;
+    telemetryFrames++;
+    framesDecoded++;
+    if (!frame->tiled) recordHistoryFrame(frame->data, frame->size);
+  }
+
+  sendFrameAck(frame->seq, frame->size, queueUs, decodeUs);
+  if (frame->tiled) {
+    sendTileStats(frame->seq, &tileStats);
+  }
+  finishStagedFrame(frame);
+}
+
+// Live frames that arrive while history is shown are released unseen and
+// not acked, like frames dropped from the queue
+void handleFrame(StagedFrame* frame) {
+  if (historyActive()) {
+    finishStagedFrame(frame);
+  } else {
+    decodeFrame(frame);
+  }
+}
+
+// Decode the newest inset frame at 1/2 or 1/4 scale into its corner
+bool decodeInsetFrame() {
+  FrameSlot* slot = takeInsetFrame();
+  if (!slot) return false;
+
+  unsigned long start = micros();
+  uint16_t w = 0, h = 0;
+  bool changed = false;
+  jpegFrameSize(slot->data, slot->size, &w, &h);
+  uint8_t scale = setInsetLayout(w, h, &changed);
+  if (changed) requestRefresh();  // Uncovered primary area is stale
+  if (scale) {
+    int16_t x, y;
+    insetOrigin(&x, &y);
+    TJpgDec.setJpgScale(scale);
+    setInsetDrawing(true);
+    JRESULT res = TJpgDec.drawJpg(x, y, slot->data, slot->size);
+    setInsetDrawing(false);
+    TJpgDec.setJpgScale(1);
+    if (res == JDR_OK) {
+      insetFrameCount++;
+    } else {
+      Serial.printf("Inset decode error: %d\n", res);
     }
   }
+  insetDecodeUs += micros() - start;
+  releaseInsetFrame(slot);
+  return true;
+}
+
+// Decode one frame, alternating between the streams when both have frames
+// waiting. With an inset connected the primary queue is only polled briefly.
+bool decodeNext(TickType_t timeout) {
+  if (insetTurn && decodeInsetFrame()) {
+    insetTurn = false;
+    return true;
+  }
+  if (insetConnected() && timeout > 1) timeout = 1;
+  StagedFrame frame;
+  if (nextStagedFrame(&frame, timeout)) {
+    handleFrame(&frame);
+    insetTurn = true;
+    return true;
+  }
+  return decodeInsetFrame();
+}
+
+void showHistoryFrame(const HistoryFrame* frame) {
+  TileStats tileStats;
+  JRESULT res = drawFrame(frame->data, frame->size, false, &tileStats);
+  if (res != JDR_OK) {
+    Serial.printf("History decode error: %d\n", res);
+  }
+}
 
-  // Look for complete JPEG frame
-  if (jpegBufferPos >= 4) {
-    size_t frameStart = 0;
-    size_t frameSize = findJpegFrame(jpegBuffer, jpegBufferPos, &frameStart);
-    
-    if (frameSize > 0) {
-      // Found complete frame, decode it
-      unsigned long decodeStart = millis();
-      
-      JRESULT res = TJpgDec.drawJpg(0, 0, jpegBuffer + frameStart, frameSize);
-      
-      decodeTimeMs += millis() - decodeStart;
-      
-      if (res != JDR_OK) {
-        Serial.printf("JPEG decode error: %d (frame size: %d)\n", res, frameSize);
+void resumeLive() {
+  historyResume();
+  requestRefresh();  // Tiles skipped while paused are missing on screen
+  Serial.println("History: live");
+}
+
+// Cooperative decode stage: one queued frame per step
+bool decodeStep() {
+  return decodeNext(0);
+}
+
+// Forward button presses to the sender on the input channel. Buttons
+// pressed while Select is held control this device and are not forwarded,
+// nor are their releases.
+void pollInput() {
+  lilka::State state = lilka::controller.getState();
+  const lilka::ButtonState* buttons[] = {
+    &state.up, &state.down, &state.left, &state.right,
+    &state.a, &state.b, &state.c, &state.d, &state.select, &state.start,
+  };
+  bool local = state.select.pressed;
+  for (uint8_t i = 0; i < sizeof(buttons) / sizeof(buttons[0]); i++) {
+    uint16_t bit = 1 << i;
+    if (buttons[i]->justPressed) {
+      if (local && buttons[i] != &state.select) {
+        localButtons |= bit;
       } else {
-        frameCount++;
-        frameId++;
+        sendInputEvent(i, true);
       }
-      
-      // Remove processed frame from buffer
-      size_t frameEnd = frameStart + frameSize;
-      if (frameEnd < jpegBufferPos) {
-        memmove(jpegBuffer, jpegBuffer + frameEnd, jpegBufferPos - frameEnd);
-        jpegBufferPos -= frameEnd;
+    }
+    if (buttons[i]->justReleased) {
+      if (localButtons & bit) {
+        localButtons &= ~bit;
       } else {
-        jpegBufferPos = 0;
+        sendInputEvent(i, false);
       }
     }
   }
 
-  // Prevent buffer overflow - discard old data if buffer is getting full
-  if (jpegBufferPos > MAX_JPEG_SIZE - 1024) {
-    Serial.println("Buffer overflow, resetting");
-    jpegBufferPos = 0;
+  if (!local) return;
+
+  // Select+D toggles the on-screen stats overlay
+  if (state.d.justPressed) {
+    osdSetEnabled(!osdEnabled());
   }
 
+  // Select+down pauses on the recorded history or returns to live,
+  // Select+left/right step through it (pausing first) and Select+start
+  // replays it at the recorded pace
+  HistoryFrame historyFrame;
+  if (state.down.justPressed) {
+    if (historyActive()) {
+      resumeLive();
+    } else {
+      historyPause();
+    }
+  }
+  if (state.left.justPressed || state.right.justPressed) {
+    if (!historyActive()) historyPause();
+    if (historyStep(state.left.justPressed ? -1 : 1, &historyFrame)) showHistoryFrame(&historyFrame);
+  }
+  if (state.start.justPressed) historyReplay();
+}
+
+// Debug commands from the serial console, so no button the sender's app
+// uses has a second meaning here
+void pollSerialCommands() {
+  while (Serial.available() > 0) {
+    int command = Serial.read();
+    if (command == 'p') {
+      // Toggle SRAM prefetch to compare decode times
+      setFramePrefetch(!framePrefetchEnabled());
+      Serial.printf("Prefetch %s\n", framePrefetchEnabled() ? "enabled" : "disabled");
+    }
+  }
+}
+
+void sendTelemetry() {
+  unsigned long now = millis();
+  if (now - lastTelemetry < TELEMETRY_INTERVAL_MS) return;
+
+  uint32_t bytes = bytesReceived();
+  float elapsed = (now - lastTelemetry) / 1000.0f;
+  DeviceStats stats;
+  stats.fpsX10 = telemetryFrames * 10 / elapsed;
+  stats.kbps = (bytes - telemetryBytes) * 8 / elapsed / 1000;
+  stats.decodeP50Us = latencyPercentile(&decodeHistogram, 50);
+  stats.decodeP90Us = latencyPercentile(&decodeHistogram, 90);
+  stats.decodeP99Us = latencyPercentile(&decodeHistogram, 99);
+  stats.framesDropped = framesDropped();
+  stats.rssi = linkRSSI();
+  updateWiFiRoaming(stats.kbps);
+  stats.queueDepth = frameQueueDepth();
+  stats.reconnects = streamConnectionCount();
+  stats.framesDecoded = framesDecoded;
+  stats.uptimeS = now / 1000;
+  sendDeviceStats(&stats);
+
+  OsdStats osd;
+  osd.fpsX10 = stats.fpsX10;
+  osd.decodeUs = stats.decodeP50Us;
+  osd.kbps = stats.kbps;
+  osd.framesDropped = stats.framesDropped - telemetryDropped;
+  osd.rssi = stats.rssi;
+  osd.queueDepth = stats.queueDepth;
+  osdUpdate(&osd);
+  if (telemetryFrames == 0) {
+    osdFinishFrame();  // Nothing was drawn this second, e.g. a static tiled screen
+  }
+
+  lastTelemetry = now;
+  telemetryFrames = 0;
+  telemetryBytes = bytes;
+  telemetryDropped = stats.framesDropped;
+  latencyReset(&decodeHistogram);
+}
+
+void printStats() {
   // Print stats every 2 seconds
   unsigned long now = millis();
-  if (now - lastStats >= 2000) {
-    float elapsed = (now - lastStats) / 1000.0f;
-    float fps = frameCount / elapsed;
-    float bandwidth = (totalBytesReceived * 8.0f) / (elapsed * 1000.0f);  // kbps
-    float avgDecode = (frameCount > 0) ? (float)decodeTimeMs / frameCount : 0;
-    
-    Serial.printf("FPS: %.1f | Bandwidth: %.1f kbps | Avg decode: %.1fms | Frames: %u\n",
-                  fps, bandwidth, avgDecode, frameId);
-    
-    frameCount = 0;
-    totalBytesReceived = 0;
-    decodeTimeMs = 0;
-    lastStats = now;
+  if (now - lastStats < 2000) return;
+
+  uint32_t bytes = bytesReceived();
+  uint32_t dropped = framesDropped();
+  float elapsed = (now - lastStats) / 1000.0f;
+  float fps = frameCount / elapsed;
+  float bandwidth = ((bytes - lastBytesReceived) * 8.0f) / (elapsed * 1000.0f);  // kbps
+  float avgDecode = (frameCount > 0) ? decodeTimeUs / 1000.0f / frameCount : 0;
+
+  float sramDecode = sramFrames ? sramDecodeUs / 1000.0f / sramFrames : 0;
+  float psramDecode = psramFrames ? psramDecodeUs / 1000.0f / psramFrames : 0;
+
+  Serial.printf("FPS: %.1f | Bandwidth: %.1f kbps | Avg decode: %.1fms (SRAM %.1fms x%u, PSRAM %.1fms x%u) | Dropped: %u | Frames: %u\n",
+                fps, bandwidth, avgDecode, sramDecode, sramFrames, psramDecode, psramFrames,
+                dropped - lastFramesDropped, frameId);
+  if (frameCount > 0) {
+    // The spread is what moving the hot path to IRAM should shrink
+    uint32_t p50 = latencyPercentile(&statsHistogram, 50);
+    uint32_t p99 = latencyPercentile(&statsHistogram, 99);
+    Serial.printf("Decode p50 %.1fms p90 %.1fms p99 %.1fms, spread %.1fms (hot path in %s)\n",
+                  p50 / 1000.0f, latencyPercentile(&statsHistogram, 90) / 1000.0f, p99 / 1000.0f,
+                  (p99 - p50) / 1000.0f, STREAM_HOT_IRAM ? "IRAM" : "flash");
   }
+  uint32_t pushes, pushUs;
+  takeDisplayPushStats(&pushes, &pushUs);
+  if (frameCount > 0) {
+    Serial.printf("Display: %.1f pushes/frame, %.2fms pushing/frame (%s)\n",
+                  (float)pushes / frameCount, pushUs / 1000.0f / frameCount,
+                  frameBatchingEnabled() ? "row batches" : "per block");
+  }
+  printHistoryStats();
 
-  return true;
+  if (rtpActive()) {
+    uint32_t rtpLost = rtpFramesLost();
+    Serial.printf("RTP/JPEG: Q%u | Lost: %u\n", rtpQuality(), rtpLost - lastRtpLost);
+    lastRtpLost = rtpLost;
+  }
+  printRelayStats();
+
+  if (insetConnected() || insetFrameCount > 0) {
+    uint32_t insetDropped = insetFramesDropped();
+    float insetDecode = insetFrameCount ? insetDecodeUs / 1000.0f / insetFrameCount : 0;
+    float primaryLoad = decodeTimeUs / (elapsed * 10000.0f);  // Percent of the decode core
+    float insetLoad = insetDecodeUs / (elapsed * 10000.0f);
+    Serial.printf("Inset FPS: %.1f | Avg decode: %.1fms | Dropped: %u | Decode load: %.0f%% + %.0f%% inset = %.0f%%\n",
+                  insetFrameCount / elapsed, insetDecode, insetDropped - lastInsetDropped,
+                  primaryLoad, insetLoad, primaryLoad + insetLoad);
+    lastInsetDropped = insetDropped;
+  }
+#if STREAM_COOPERATIVE
+  Serial.printf("Longest gap between network reads: %.1fms\n", coopTakeMaxGap("rx") / 1000.0f);
+#endif
+
+  frameCount = 0;
+  decodeTimeUs = 0;
+  sramDecodeUs = psramDecodeUs = 0;
+  sramFrames = psramFrames = 0;
+  latencyReset(&statsHistogram);
+  insetFrameCount = 0;
+  insetDecodeUs = 0;
+  lastBytesReceived = bytes;
+  lastFramesDropped = dropped;
+  lastStats = now;
 }
 
 void loop() {
-  handleClient();
-  
-  if (client && !client.connected()) {
-    Serial.println("Client disconnected");
-    jpegBufferPos = 0;  // Reset buffer
+#if STREAM_COOPERATIVE
+  if (!coopRunOnce()) {
+    vTaskDelay(1);  // Idle: let the WiFi stack run
+  }
+#else
+  decodeNext(pdMS_TO_TICKS(10));
+#endif
+
+  pollWiFiRoaming();
+  pollSerialCommands();
+
+  HistoryFrame historyFrame;
+  if (historyNextReplayFrame(&historyFrame)) {
+    showHistoryFrame(&historyFrame);
+  }
+
+  // The corner the inset covered shows the primary stream again
+  bool insetIsConnected = insetConnected();
+  if (insetIsConnected != insetWasConnected) {
+    insetWasConnected = insetIsConnected;
+    bool changed = false;
+    if (!insetIsConnected) setInsetLayout(0, 0, &changed);
+    if (changed) requestRefresh();
+  }
+
+  bool isConnected = streamConnected() || rtpActive();
+  if (isConnected != wasConnected) {
+    wasConnected = isConnected;
+    if (isConnected) {
+      resetStats();
+    } else {
+      dropStagedFrames();
+      historyResume();
+      showWaitingScreen();
+    }
+  }
+
+  if (isConnected) {
+    pollInput();
+    sendTelemetry();
+    printStats();
+  } else if (lilka::controller.getState().b.justPressed) {
+    // B on the waiting screen reruns the self-benchmark
+    runSelfBenchmark(tjpgd_output);
     showWaitingScreen();
   }
-  
-  delay(1);
-}
\ No newline at end of file
+}
@@ -0,0 +1,55 @@
+#include "mjpeg_scanner.h"
+#include "hot_path.h"
+
+void mjpegScanReset(MjpegScanner* scanner) {
+  scanner->scanPos = 0;
+}
+
+FrameSlot* HOT_IRAM mjpegScan(MjpegScanner* scanner, FrameSlot* slot) {
+  while (slot->size >= 2) {
+    uint8_t* buf = slot->data;
+    size_t len = slot->size;
+
+    // Discard anything before the SOI marker
+    if (!(buf[0] == 0xFF && buf[1] == 0xD8)) {
+      size_t i = 1;
+      while (i < len - 1 && !(buf[i] == 0xFF && buf[i + 1] == 0xD8)) i++;
+      memmove(buf, buf + i, len - i);
+      slot->size = len - i;
+      scanner->scanPos = 0;
+      continue;
+    }
+
+    // Look for EOI marker
+    size_t frameSize = 0;
+    for (size_t j = max(scanner->scanPos, (size_t)2); j < len - 1; j++) {
+      if (buf[j] == 0xFF && buf[j + 1] == 0xD9) {
+        frameSize = j + 2;
+        break;
+      }
+    }
+    if (frameSize == 0) {
+      scanner->scanPos = len - 1;
+      break;
+    }
+
+    // Move bytes past the frame into a fresh slot
+    FrameSlot* next = acquirePoolSlot(scanner->pool);
+    size_t rest = len - frameSize;
+    memcpy(next->data, buf + frameSize, rest);
+    next->size = rest;
+    slot->size = frameSize;
+    slot->tiled = false;
+    scanner->sink(slot);
+    slot = next;
+    scanner->scanPos = 0;
+  }
+
+  // Prevent buffer overflow - discard data if no EOI shows up
+  if (slot->size > scanner->pool->capacity - 1024) {
+    Serial.println("MJPEG frame too large, resetting");
+    slot->size = 0;
+    scanner->scanPos = 0;
+  }
+  return slot;
+}
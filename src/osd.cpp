@@ -0,0 +1,131 @@
+#include "osd.h"
+#include "hot_path.h"
+#include <lilka.h>
+
+// 3x5 glyphs drawn at 2x in an 8x12 cell
+#define GLYPH_SCALE 2
+#define CELL_W 8
+#define CELL_H 12
+#define OSD_PAD 2
+#define OSD_WIDTH (OSD_COLS * CELL_W + OSD_PAD * 2)
+#define OSD_HEIGHT (OSD_ROWS * CELL_H + OSD_PAD * 2)
+#define OSD_PIXELS (OSD_WIDTH * OSD_HEIGHT)
+
+// Rows pushed per display call when the overlay is redrawn on its own
+#define PUSH_ROWS 8
+
+static const char GLYPH_CHARS[] = "0123456789.-FPSMKBQDROI";
+static const uint8_t GLYPHS[][5] = {
+  {7, 5, 5, 5, 7}, {2, 6, 2, 2, 7}, {7, 1, 7, 4, 7}, {7, 1, 7, 1, 7},  // 0-3
+  {5, 5, 7, 1, 1}, {7, 4, 7, 1, 7}, {7, 4, 7, 5, 7}, {7, 1, 2, 2, 2},  // 4-7
+  {7, 5, 7, 5, 7}, {7, 5, 7, 1, 7}, {0, 0, 0, 0, 2}, {0, 0, 7, 0, 0},  // 8-9 . -
+  {7, 4, 6, 4, 4}, {6, 5, 6, 4, 4}, {3, 4, 2, 1, 6}, {5, 7, 7, 5, 5},  // F P S M
+  {5, 5, 6, 5, 5}, {6, 5, 6, 5, 6}, {2, 5, 5, 6, 3}, {6, 5, 5, 5, 6},  // K B Q D
+  {6, 5, 6, 5, 5}, {2, 5, 5, 5, 2}, {7, 2, 2, 2, 7},                   // R O I
+};
+
+static bool enabled = false;
+static bool dirty = false;    // Text or visibility changed since the last full cover
+static uint32_t covered = 0;  // Overlay pixels repainted by the current frame
+
+static uint8_t textMask[(OSD_PIXELS + 7) / 8];
+static uint16_t background[OSD_PIXELS];  // Display contents under the overlay
+static uint16_t pushBuffer[OSD_WIDTH * PUSH_ROWS];
+
+static inline bool maskBit(uint32_t i) {
+  return textMask[i >> 3] & (1 << (i & 7));
+}
+
+static inline uint16_t blendPixel(uint32_t i, uint16_t pixel) {
+  if (maskBit(i)) return lilka::colors::White;
+  return (pixel >> 1) & 0x7BEF;  // Half brightness keeps the text readable
+}
+
+static void drawGlyph(uint8_t col, uint8_t row, char c) {
+  const char* found = strchr(GLYPH_CHARS, c);
+  if (c == '\0' || found == NULL) return;
+  const uint8_t* glyph = GLYPHS[found - GLYPH_CHARS];
+
+  for (uint8_t gy = 0; gy < 5 * GLYPH_SCALE; gy++) {
+    uint8_t bits = glyph[gy / GLYPH_SCALE];
+    for (uint8_t gx = 0; gx < 3 * GLYPH_SCALE; gx++) {
+      if (!(bits & (4 >> (gx / GLYPH_SCALE)))) continue;
+      uint32_t px = OSD_PAD + col * CELL_W + gx;
+      uint32_t py = OSD_PAD + row * CELL_H + gy;
+      uint32_t i = py * OSD_WIDTH + px;
+      textMask[i >> 3] |= 1 << (i & 7);
+    }
+  }
+}
+
+void osdSetEnabled(bool value) {
+  if (value == enabled) return;
+  enabled = value;
+  dirty = true;
+}
+
+bool osdEnabled() {
+  return enabled;
+}
+
+void osdUpdate(const OsdStats* stats) {
+  char lines[OSD_ROWS][OSD_COLS + 1];
+  snprintf(lines[0], sizeof(lines[0]), "%u.%uFPS %lu.%luMS",
+           stats->fpsX10 / 10, stats->fpsX10 % 10,
+           (unsigned long)(stats->decodeUs / 1000), (unsigned long)(stats->decodeUs / 100 % 10));
+  snprintf(lines[1], sizeof(lines[1]), "%uKBPS Q%u", stats->kbps, stats->queueDepth);
+  // At most "D9999 -128DBM", so RSSI is never cut off
+  snprintf(lines[2], sizeof(lines[2]), "D%lu %dDBM",
+           (unsigned long)min(stats->framesDropped, (uint32_t)9999), stats->rssi);
+
+  memset(textMask, 0, sizeof(textMask));
+  for (uint8_t row = 0; row < OSD_ROWS; row++) {
+    for (uint8_t col = 0; lines[row][col]; col++) {
+      drawGlyph(col, row, lines[row][col]);
+    }
+  }
+  if (enabled) dirty = true;
+}
+
+// The background is copied even while the overlay is hidden, so showing it
+// over a region that is not repainted never brings back stale pixels
+void HOT_IRAM osdComposite(int16_t x, int16_t y, uint16_t w, uint16_t h, uint16_t* bitmap) {
+  // Intersect the block with the overlay rectangle
+  int16_t left = max((int)x, OSD_X);
+  int16_t top = max((int)y, OSD_Y);
+  int16_t right = min(x + w, OSD_X + OSD_WIDTH);
+  int16_t bottom = min(y + h, OSD_Y + OSD_HEIGHT);
+  if (left >= right || top >= bottom) return;
+
+  for (int16_t py = top; py < bottom; py++) {
+    uint16_t* src = bitmap + (py - y) * w + (left - x);
+    uint32_t i = (py - OSD_Y) * OSD_WIDTH + (left - OSD_X);
+    for (int16_t px = left; px < right; px++, src++, i++) {
+      background[i] = *src;
+      if (enabled) *src = blendPixel(i, *src);
+    }
+  }
+  covered += (right - left) * (bottom - top);
+}
+
+void osdFinishFrame() {
+  if (dirty && covered < OSD_PIXELS) {
+    for (uint16_t row = 0; row < OSD_HEIGHT; row += PUSH_ROWS) {
+      uint16_t rows = min(PUSH_ROWS, OSD_HEIGHT - row);
+      uint32_t start = row * OSD_WIDTH;
+      for (uint32_t i = 0; i < rows * OSD_WIDTH; i++) {
+        uint16_t pixel = background[start + i];
+        pushBuffer[i] = enabled ? blendPixel(start + i, pixel) : pixel;
+      }
+      lilka::display.draw16bitRGBBitmap(OSD_X, OSD_Y + row, pushBuffer, OSD_WIDTH, rows);
+    }
+  }
+  dirty = false;
+  covered = 0;
+}
+
+void osdBackgroundCleared() {
+  memset(background, 0, sizeof(background));  // Black
+  covered = 0;
+  if (enabled) dirty = true;
+}
@@ -0,0 +1,410 @@
+#include "rtp_receiver.h"
+#include "frame_queue.h"
+#include "frame_relay.h"
+#include "coop_scheduler.h"
+#include "hot_path.h"
+#include <lwip/sockets.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+// Same core and priority as the TCP network task
+#define RTP_TASK_CORE       0
+#define RTP_TASK_PRIORITY   3
+#define RTP_TASK_STACK      3072
+#define RTP_MAX_PACKET      1500
+#define RTP_PACKETS_PER_STEP 8
+#define RTP_TIMEOUT_MS      1000
+
+#define RTP_HEADER_SIZE     12
+#define JPEG_HEADER_SIZE    8   // RFC 2435 3.1
+#define RESTART_HEADER_SIZE 4   // Types 64-127
+#define QTABLE_HEADER_SIZE  4   // Q 128-255, first fragment only
+#define QTABLE_CACHE        4
+
+enum FrameState { FRAME_IDLE, FRAME_ASSEMBLING, FRAME_DONE };
+
+// Luma then chroma table, zigzag order as in DQT
+struct QuantTables {
+  uint8_t q;  // 0 = empty
+  uint8_t tables[128];
+};
+
+static int sock = -1;
+static uint8_t packet[RTP_MAX_PACKET];  // lwIP copies each datagram once, into here
+
+static volatile bool active = false;
+static volatile uint32_t bytesReceived = 0;
+static volatile uint32_t framesLost = 0;
+static volatile uint8_t lastQ = 0;
+static unsigned long lastPacketMs = 0;
+
+static QuantTables qcache[QTABLE_CACHE];
+static uint8_t qcacheNext = 0;
+
+// Frame being reassembled: scan data goes right after the rebuilt headers
+static FrameSlot* rxSlot = nullptr;
+static FrameState state = FRAME_IDLE;
+static uint32_t rxTimestamp = 0;
+static uint32_t rxSeq = 0;
+static size_t headerSize = 0;
+static uint32_t nextOffset = 0;
+
+// JPEG Annex K tables (K.1, K.2 in natural order; K.3-K.6)
+static const uint8_t LUMA_QUANT[64] = {
+  16, 11, 10, 16, 24, 40, 51, 61,      12, 12, 14, 19, 26, 58, 60, 55,
+  14, 13, 16, 24, 40, 57, 69, 56,      14, 17, 22, 29, 51, 87, 80, 62,
+  18, 22, 37, 56, 68, 109, 103, 77,    24, 35, 55, 64, 81, 104, 113, 92,
+  49, 64, 78, 87, 103, 121, 120, 101,  72, 92, 95, 98, 112, 100, 103, 99,
+};
+static const uint8_t CHROMA_QUANT[64] = {
+  17, 18, 24, 47, 99, 99, 99, 99,  18, 21, 26, 66, 99, 99, 99, 99,
+  24, 26, 56, 99, 99, 99, 99, 99,  47, 66, 99, 99, 99, 99, 99, 99,
+  99, 99, 99, 99, 99, 99, 99, 99,  99, 99, 99, 99, 99, 99, 99, 99,
+  99, 99, 99, 99, 99, 99, 99, 99,  99, 99, 99, 99, 99, 99, 99, 99,
+};
+// Natural-order index of each zigzag position
+static const uint8_t ZIGZAG[64] = {
+  0, 1, 8, 16, 9, 2, 3, 10, 17, 24, 32, 25, 18, 11, 4, 5,
+  12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6, 7, 14, 21, 28,
+  35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+  58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63,
+};
+
+static const uint8_t LUMA_DC_BITS[16] = {0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0};
+static const uint8_t CHROMA_DC_BITS[16] = {0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0};
+static const uint8_t DC_VALUES[12] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11};
+static const uint8_t LUMA_AC_BITS[16] = {0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7d};
+static const uint8_t LUMA_AC_VALUES[162] = {
+  0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
+  0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xa1, 0x08, 0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0,
+  0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0a, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x25, 0x26, 0x27, 0x28,
+  0x29, 0x2a, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+  0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+  0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+  0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7,
+  0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5,
+  0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe1, 0xe2,
+  0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+  0xf9, 0xfa,
+};
+static const uint8_t CHROMA_AC_BITS[16] = {0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77};
+static const uint8_t CHROMA_AC_VALUES[162] = {
+  0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71,
+  0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xa1, 0xb1, 0xc1, 0x09, 0x23, 0x33, 0x52, 0xf0,
+  0x15, 0x62, 0x72, 0xd1, 0x0a, 0x16, 0x24, 0x34, 0xe1, 0x25, 0xf1, 0x17, 0x18, 0x19, 0x1a, 0x26,
+  0x27, 0x28, 0x29, 0x2a, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48,
+  0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+  0x69, 0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+  0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5,
+  0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3,
+  0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda,
+  0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+  0xf9, 0xfa,
+};
+
+// Q 1-99 scales the Annex K tables like libjpeg (RFC 2435 appendix A)
+static void makeTables(uint8_t q, uint8_t* tables) {
+  int factor = constrain(q, 1, 99);
+  int scale = factor < 50 ? 5000 / factor : 200 - factor * 2;
+  for (int i = 0; i < 64; i++) {
+    tables[i] = constrain((LUMA_QUANT[ZIGZAG[i]] * scale + 50) / 100, 1, 255);
+    tables[64 + i] = constrain((CHROMA_QUANT[ZIGZAG[i]] * scale + 50) / 100, 1, 255);
+  }
+}
+
+static const uint8_t* cachedTables(uint8_t q) {
+  for (int i = 0; i < QTABLE_CACHE; i++) {
+    if (qcache[i].q == q) return qcache[i].tables;
+  }
+  return nullptr;
+}
+
+static uint8_t* cacheEntry(uint8_t q) {
+  QuantTables* entry = &qcache[qcacheNext];
+  qcacheNext = (qcacheNext + 1) % QTABLE_CACHE;
+  entry->q = q;
+  return entry->tables;
+}
+
+static uint8_t* putMarker(uint8_t* p, uint8_t marker, uint16_t length) {
+  *p++ = 0xFF;
+  *p++ = marker;
+  *p++ = length >> 8;
+  *p++ = length & 0xFF;
+  return p;
+}
+
+static uint8_t* putHuffman(uint8_t* p, uint8_t tableClassId, const uint8_t* bits,
+                           const uint8_t* values, size_t count) {
+  p = putMarker(p, 0xC4, 3 + 16 + count);
+  *p++ = tableClassId;
+  memcpy(p, bits, 16);
+  memcpy(p + 16, values, count);
+  return p + 16 + count;
+}
+
+// SOI, DQT, SOF0, DRI, DHT and SOS for a baseline 3-component frame
+// (RFC 2435 appendix B); returns the header size
+static size_t writeHeaders(uint8_t* out, uint8_t type, uint16_t w, uint16_t h,
+                           const uint8_t* tables, uint16_t restartInterval) {
+  uint8_t* p = out;
+  *p++ = 0xFF;
+  *p++ = 0xD8;
+
+  p = putMarker(p, 0xDB, 2 + 2 * 65);
+  *p++ = 0;
+  memcpy(p, tables, 64);
+  p += 64;
+  *p++ = 1;
+  memcpy(p, tables + 64, 64);
+  p += 64;
+
+  p = putMarker(p, 0xC0, 17);
+  *p++ = 8;
+  *p++ = h >> 8;
+  *p++ = h & 0xFF;
+  *p++ = w >> 8;
+  *p++ = w & 0xFF;
+  *p++ = 3;
+  *p++ = 1;
+  *p++ = (type & 1) ? 0x22 : 0x21;  // Type 1 is 4:2:0, type 0 is 4:2:2
+  *p++ = 0;
+  *p++ = 2;
+  *p++ = 0x11;
+  *p++ = 1;
+  *p++ = 3;
+  *p++ = 0x11;
+  *p++ = 1;
+
+  if (restartInterval) {
+    p = putMarker(p, 0xDD, 4);
+    *p++ = restartInterval >> 8;
+    *p++ = restartInterval & 0xFF;
+  }
+
+  p = putHuffman(p, 0x00, LUMA_DC_BITS, DC_VALUES, sizeof(DC_VALUES));
+  p = putHuffman(p, 0x10, LUMA_AC_BITS, LUMA_AC_VALUES, sizeof(LUMA_AC_VALUES));
+  p = putHuffman(p, 0x01, CHROMA_DC_BITS, DC_VALUES, sizeof(DC_VALUES));
+  p = putHuffman(p, 0x11, CHROMA_AC_BITS, CHROMA_AC_VALUES, sizeof(CHROMA_AC_VALUES));
+
+  p = putMarker(p, 0xDA, 12);
+  *p++ = 3;
+  *p++ = 1;
+  *p++ = 0x00;
+  *p++ = 2;
+  *p++ = 0x11;
+  *p++ = 3;
+  *p++ = 0x11;
+  *p++ = 0;
+  *p++ = 63;
+  *p++ = 0;
+  return p - out;
+}
+
+static void dropFrame() {
+  framesLost++;
+  state = FRAME_DONE;
+}
+
+// First fragment: pick the quantisation tables and write the headers.
+// Advances data past the table header, if any.
+static bool beginFrame(uint8_t type, uint8_t q, uint16_t w, uint16_t h, uint16_t restartInterval,
+                       const uint8_t** data, size_t* len) {
+  if ((type & 0x3F) > 1 || type >= 128 || q == 0 || w == 0 || h == 0) {
+    static bool warned = false;
+    if (!warned) {
+      Serial.printf("RTP/JPEG type %u, Q %u, %ux%u not supported\n", type, q, w, h);
+      warned = true;
+    }
+    return false;
+  }
+
+  const uint8_t* tables = nullptr;
+  if (q < 128) {
+    tables = cachedTables(q);
+    if (!tables) {
+      uint8_t* entry = cacheEntry(q);
+      makeTables(q, entry);
+      tables = entry;
+    }
+  } else {
+    if (*len < QTABLE_HEADER_SIZE) return false;
+    const uint8_t* qh = *data;
+    uint16_t length = (qh[2] << 8) | qh[3];
+    if (qh[1] != 0) return false;  // 16-bit tables; TJpgDec takes 8-bit only
+    if (*len < (size_t)QTABLE_HEADER_SIZE + length) return false;
+    if (length >= 128) {
+      tables = qh + QTABLE_HEADER_SIZE;
+      // Q 255 tables may change every frame; 128-254 are fixed per Q
+      if (q != 255) memcpy(cacheEntry(q), tables, 128);
+    } else if (length == 0 && q != 255) {
+      tables = cachedTables(q);
+    }
+    if (!tables) return false;
+    *data += QTABLE_HEADER_SIZE + length;
+    *len -= QTABLE_HEADER_SIZE + length;
+  }
+
+  if (!rxSlot) rxSlot = acquireFrameSlot();
+  headerSize = writeHeaders(rxSlot->data, type, w, h, tables, restartInterval);
+  nextOffset = 0;
+  lastQ = q;
+  return true;
+}
+
+static void HOT_IRAM handlePacket(const uint8_t* p, size_t len) {
+  if (len < RTP_HEADER_SIZE + JPEG_HEADER_SIZE || (p[0] >> 6) != 2) return;
+  bool marker = (p[1] & 0x80) != 0;
+  uint32_t timestamp = (p[4] << 24) | (p[5] << 16) | (p[6] << 8) | p[7];
+  size_t pos = RTP_HEADER_SIZE + (p[0] & 0x0F) * 4;  // Skip CSRCs
+  if (p[0] & 0x10) {  // Header extension
+    if (pos + 4 > len) return;
+    pos += 4 + ((p[pos + 2] << 8) | p[pos + 3]) * 4;
+  }
+  if (p[0] & 0x20) {  // Padding
+    if (p[len - 1] > len) return;
+    len -= p[len - 1];
+  }
+  if (pos + JPEG_HEADER_SIZE > len) return;
+
+  const uint8_t* jh = p + pos;
+  uint32_t offset = (jh[1] << 16) | (jh[2] << 8) | jh[3];
+  uint8_t type = jh[4];
+  uint8_t q = jh[5];
+  pos += JPEG_HEADER_SIZE;
+  uint16_t restartInterval = 0;
+  if (type >= 64 && type < 128) {
+    if (pos + RESTART_HEADER_SIZE > len) return;
+    restartInterval = (p[pos] << 8) | p[pos + 1];
+    pos += RESTART_HEADER_SIZE;
+  }
+  const uint8_t* data = p + pos;
+  size_t dataLen = len - pos;
+
+  if (state == FRAME_IDLE || timestamp != rxTimestamp) {
+    if (state != FRAME_IDLE && (int32_t)(timestamp - rxTimestamp) < 0) return;  // Late packet
+    if (state == FRAME_ASSEMBLING) framesLost++;  // Previous frame lost its last fragment
+    rxTimestamp = timestamp;
+    state = FRAME_DONE;
+    if (offset != 0) {
+      dropFrame();  // First fragment lost
+      return;
+    }
+    if (!beginFrame(type, q, jh[6] * 8, jh[7] * 8, restartInterval, &data, &dataLen)) {
+      dropFrame();
+      return;
+    }
+    state = FRAME_ASSEMBLING;
+  } else if (state != FRAME_ASSEMBLING) {
+    return;
+  } else if (offset != nextOffset) {
+    dropFrame();  // A fragment in between was lost or reordered
+    return;
+  }
+
+  // Keep two bytes for an EOI the sender may have left out
+  if (headerSize + offset + dataLen + 2 > frameSlotCapacity()) {
+    Serial.println("RTP frame too large, dropped");
+    dropFrame();
+    return;
+  }
+  memcpy(rxSlot->data + headerSize + offset, data, dataLen);
+  nextOffset += dataLen;
+  if (!marker) return;
+
+  size_t size = headerSize + nextOffset;
+  uint8_t* buf = rxSlot->data;
+  if (size < 2 || buf[size - 2] != 0xFF || buf[size - 1] != 0xD9) {
+    buf[size++] = 0xFF;
+    buf[size++] = 0xD9;
+  }
+  rxSlot->size = size;
+  rxSlot->seq = ++rxSeq;
+  rxSlot->tiled = false;
+  relayFrame(rxSlot);
+  submitFrameSlot(rxSlot);
+  rxSlot = nullptr;
+  state = FRAME_DONE;
+}
+
+static void onTimeout() {
+  Serial.println("RTP/JPEG stream stopped");
+  active = false;
+  state = FRAME_IDLE;
+  if (rxSlot) {
+    releaseFrameSlot(rxSlot);
+    rxSlot = nullptr;
+  }
+  flushFrameQueue();
+}
+
+static bool serviceRtp() {
+  bool progress = false;
+  for (int i = 0; i < RTP_PACKETS_PER_STEP; i++) {
+    int len = recv(sock, packet, sizeof(packet), MSG_DONTWAIT);
+    if (len <= 0) break;
+    bytesReceived += len;
+    lastPacketMs = millis();
+    if (!active) {
+      Serial.println("RTP/JPEG stream started");
+      rxSeq = 0;
+      active = true;
+    }
+    handlePacket(packet, len);
+    progress = true;
+  }
+  if (!progress && active && millis() - lastPacketMs > RTP_TIMEOUT_MS) onTimeout();
+  return progress;
+}
+
+static void rtpTask(void* arg) {
+  for (;;) {
+    if (!serviceRtp()) {
+      vTaskDelay(1);
+    }
+  }
+}
+
+bool beginRtpReceiver() {
+  // A plain socket rather than WiFiUDP, which allocates and copies every
+  // datagram once more before it can be read
+  sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  if (sock < 0) return false;
+  sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(RTP_PORT);
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  if (bind(sock, (sockaddr*)&addr, sizeof(addr)) < 0) {
+    close(sock);
+    sock = -1;
+    return false;
+  }
+  Serial.printf("RTP/JPEG listening on UDP port %d\n", RTP_PORT);
+
+#if STREAM_COOPERATIVE
+  return true;
+#else
+  return xTaskCreatePinnedToCore(rtpTask, "rtp_rx", RTP_TASK_STACK, nullptr,
+                                 RTP_TASK_PRIORITY, nullptr, RTP_TASK_CORE) == pdPASS;
+#endif
+}
+
+bool pollRtpReceiver() {
+  return serviceRtp();
+}
+
+bool rtpActive() {
+  return active;
+}
+
+uint32_t rtpBytesReceived() {
+  return bytesReceived;
+}
+
+uint32_t rtpFramesLost() {
+  return framesLost;
+}
+
+uint8_t rtpQuality() {
+  return lastQ;
+}
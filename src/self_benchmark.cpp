@@ -0,0 +1,198 @@
+#include "self_benchmark.h"
+#include "display_calibration.h"
+#include "frame_layout.h"
+#include "hot_path.h"
+#include <lilka.h>
+#include <Preferences.h>
+#include <esp_heap_caps.h>
+#include <esp_rom_crc.h>
+
+#define REPEATS 5
+
+// Files listed in board_build.embed_files
+#define EMBEDDED_JPEG(name) \
+  extern const uint8_t name##_start[] asm("_binary_assets_bench_" #name "_jpg_start"); \
+  extern const uint8_t name##_end[] asm("_binary_assets_bench_" #name "_jpg_end");
+
+EMBEDDED_JPEG(text_q30)
+EMBEDDED_JPEG(text_q50)
+EMBEDDED_JPEG(text_q80)
+EMBEDDED_JPEG(photo_q30)
+EMBEDDED_JPEG(photo_q50)
+EMBEDDED_JPEG(photo_q80)
+EMBEDDED_JPEG(ui_q30)
+EMBEDDED_JPEG(ui_q50)
+EMBEDDED_JPEG(ui_q80)
+EMBEDDED_JPEG(ui_half_q50)
+
+struct CorpusImage {
+  const char* name;
+  const uint8_t* start;
+  const uint8_t* end;
+};
+
+#define CORPUS_ENTRY(name) {#name, name##_start, name##_end}
+
+static const CorpusImage CORPUS[] = {
+  CORPUS_ENTRY(text_q30), CORPUS_ENTRY(text_q50), CORPUS_ENTRY(text_q80),
+  CORPUS_ENTRY(photo_q30), CORPUS_ENTRY(photo_q50), CORPUS_ENTRY(photo_q80),
+  CORPUS_ENTRY(ui_q30), CORPUS_ENTRY(ui_q50), CORPUS_ENTRY(ui_q80),
+  CORPUS_ENTRY(ui_half_q50),
+};
+#define CORPUS_COUNT (sizeof(CORPUS) / sizeof(CORPUS[0]))
+
+enum BenchMode { MODE_DECODE, MODE_DECODE_PSRAM, MODE_DECODE_HALF, MODE_STRIPS, MODE_BLOCKS, MODE_COUNT };
+
+// Average time per frame in one mode; pushUs only for the display modes
+struct ModeTiming {
+  uint32_t totalUs;
+  uint32_t pushUs;
+  bool ok;
+};
+
+static bool discardBlock(int16_t x, int16_t y, uint16_t w, uint16_t h, uint16_t* bitmap) {
+  return true;
+}
+
+static void showMessage(const char* title, const char* line1, const char* line2) {
+  lilka::display.fillScreen(lilka::colors::Black);
+  lilka::display.setTextSize(1);
+  lilka::display.setTextColor(lilka::colors::White);
+  lilka::display.setCursor(10, 60);
+  lilka::display.println(title);
+  lilka::display.setTextColor(lilka::colors::Cyan);
+  lilka::display.setCursor(10, 100);
+  lilka::display.println(line1);
+  lilka::display.setCursor(10, 120);
+  lilka::display.println(line2);
+}
+
+static ModeTiming runMode(BenchMode mode, const uint8_t* sram, const uint8_t* psram, size_t size,
+                          SketchCallback output) {
+  ModeTiming timing = {0, 0, true};
+  const uint8_t* data = mode == MODE_DECODE_PSRAM ? psram : sram;
+  if (!data) {
+    timing.ok = false;
+    return timing;
+  }
+
+  bool display = mode == MODE_STRIPS || mode == MODE_BLOCKS;
+  TJpgDec.setCallback(display ? output : discardBlock);
+  TJpgDec.setJpgScale(mode == MODE_DECODE_HALF ? 2 : 1);
+  setFrameBatching(mode != MODE_BLOCKS);
+  if (display) {
+    uint16_t w, h;
+    if (jpegFrameSize(data, size, &w, &h)) setFrameLayout(w, h);
+  }
+
+  uint32_t pushes, pushUs;
+  takeDisplayPushStats(&pushes, &pushUs);
+  for (int i = 0; i < REPEATS; i++) {
+    unsigned long start = micros();
+    if (TJpgDec.drawJpg(0, 0, data, size) != JDR_OK) timing.ok = false;
+    if (display) flushFrameBlocks();
+    timing.totalUs += micros() - start;
+  }
+  takeDisplayPushStats(&pushes, &pushUs);
+  timing.totalUs /= REPEATS;
+  timing.pushUs = display ? pushUs / REPEATS : 0;
+  return timing;
+}
+
+void runSelfBenchmark(SketchCallback output) {
+  size_t largest = 0, corpusBytes = 0;
+  uint32_t crc = 0;
+  for (size_t i = 0; i < CORPUS_COUNT; i++) {
+    size_t size = CORPUS[i].end - CORPUS[i].start;
+    largest = max(largest, size);
+    corpusBytes += size;
+    crc = esp_rom_crc32_le(crc, CORPUS[i].start, size);
+  }
+
+  // Streamed frames never decode from flash: copy each image to where
+  // the receive path would have put it
+  uint8_t* sram = (uint8_t*)heap_caps_malloc(largest, MALLOC_CAP_INTERNAL);
+  uint8_t* psram = (uint8_t*)heap_caps_malloc(largest, MALLOC_CAP_SPIRAM);
+  if (!sram) {
+    showMessage("Self-benchmark", "Not enough memory", "");
+    delay(2000);
+    heap_caps_free(psram);
+    return;
+  }
+
+  Preferences prefs;
+  uint32_t spiHz = 0;
+  if (prefs.begin(SETTINGS_NAMESPACE, true)) {
+    spiHz = prefs.getUInt("spi_hz", 0);
+    prefs.end();
+  }
+  bool batching = frameBatchingEnabled();
+
+  Serial.printf("Self-benchmark: %s @ %u MHz, SPI %s%u MHz, hot path in %s, corpus %u images "
+                "%u bytes crc %08x\n",
+                ESP.getChipModel(), ESP.getCpuFreqMHz(), spiHz ? "" : "default ",
+                spiHz / 1000000, STREAM_HOT_IRAM ? "IRAM" : "flash", CORPUS_COUNT,
+                corpusBytes, crc);
+  Serial.println("image          bytes   decode    psram     half  strips (push)   blocks (push)   MB/s");
+
+  uint64_t sums[MODE_COUNT] = {0}, pushSums[MODE_COUNT] = {0};
+  uint32_t counts[MODE_COUNT] = {0};
+  uint64_t pixels = 0;
+  for (size_t i = 0; i < CORPUS_COUNT; i++) {
+    const CorpusImage* image = &CORPUS[i];
+    size_t size = image->end - image->start;
+    memcpy(sram, image->start, size);
+    if (psram) memcpy(psram, image->start, size);
+    uint16_t w = 0, h = 0;
+    jpegFrameSize(sram, size, &w, &h);
+    pixels += (uint32_t)w * h;
+
+    ModeTiming timings[MODE_COUNT];
+    for (int m = 0; m < MODE_COUNT; m++) {
+      timings[m] = runMode((BenchMode)m, sram, psram, size, output);
+      if (!timings[m].ok) continue;
+      sums[m] += timings[m].totalUs;
+      pushSums[m] += timings[m].pushUs;
+      counts[m]++;
+    }
+
+    const ModeTiming* t = timings;
+    Serial.printf("%-12s %6u %8u %8u %8u %7u (%5u) %7u (%5u) %6.2f\n", image->name, size,
+                  t[MODE_DECODE].totalUs, t[MODE_DECODE_PSRAM].ok ? t[MODE_DECODE_PSRAM].totalUs : 0,
+                  t[MODE_DECODE_HALF].totalUs, t[MODE_STRIPS].totalUs, t[MODE_STRIPS].pushUs,
+                  t[MODE_BLOCKS].totalUs, t[MODE_BLOCKS].pushUs,
+                  t[MODE_DECODE].totalUs ? (float)size / t[MODE_DECODE].totalUs : 0);
+  }
+
+  heap_caps_free(sram);
+  heap_caps_free(psram);
+  TJpgDec.setCallback(output);
+  TJpgDec.setJpgScale(1);
+  setFrameBatching(batching);
+  resetFrameLayout();
+
+  uint32_t avg[MODE_COUNT], avgPush[MODE_COUNT];
+  for (int m = 0; m < MODE_COUNT; m++) {
+    avg[m] = counts[m] ? sums[m] / counts[m] : 0;
+    avgPush[m] = counts[m] ? pushSums[m] / counts[m] : 0;
+  }
+  // Compressed throughput of the decoder, pixel throughput of the whole pipeline
+  float mbPerS = sums[MODE_DECODE] ? (float)corpusBytes / sums[MODE_DECODE] : 0;
+  float mpixPerS = sums[MODE_STRIPS] ? (float)pixels / sums[MODE_STRIPS] : 0;
+  Serial.printf("Fingerprint: crc %08x | decode %u psram %u half %u strips %u/%u blocks %u/%u us/frame"
+                " | %.2f MB/s | %.2f Mpix/s | %u MHz, SPI %u MHz, %s\n",
+                crc, avg[MODE_DECODE], avg[MODE_DECODE_PSRAM], avg[MODE_DECODE_HALF],
+                avg[MODE_STRIPS], avgPush[MODE_STRIPS], avg[MODE_BLOCKS], avgPush[MODE_BLOCKS],
+                mbPerS, mpixPerS, ESP.getCpuFreqMHz(), spiHz / 1000000,
+                STREAM_HOT_IRAM ? "iram" : "flash");
+
+  char line1[40], line2[40];
+  snprintf(line1, sizeof(line1), "Decode %.1fms, %.2f MB/s", avg[MODE_DECODE] / 1000.0f, mbPerS);
+  snprintf(line2, sizeof(line2), "Push %.1fms, total %.1fms", avgPush[MODE_STRIPS] / 1000.0f,
+           avg[MODE_STRIPS] / 1000.0f);
+  showMessage("Self-benchmark (A - continue)", line1, line2);
+  lilka::controller.resetState();
+  while (!lilka::controller.getState().a.justPressed) {
+    vTaskDelay(pdMS_TO_TICKS(10));
+  }
+}
@@ -0,0 +1,450 @@
+#include "stream_receiver.h"
+#include "stream_protocol.h"
+#include "frame_queue.h"
+#include "frame_relay.h"
+#include "mjpeg_scanner.h"
+#include "coop_scheduler.h"
+#include "hot_path.h"
+#include <WiFi.h>
+#include <WiFiServer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
+
+// Network task runs next to the WiFi stack on core 0, the decode loop on core 1
+#define NET_TASK_CORE      0
+#define NET_TASK_PRIORITY  3
+#define NET_TASK_STACK     4096
+#define NET_READ_CHUNK     2048
+#define ACCEPT_INTERVAL_MS 10
+#define UPSTREAM_QUEUE_LEN 16
+
+enum StreamMode { MODE_DETECT, MODE_RAW, MODE_MUX };
+
+struct UpstreamMessage {
+  uint8_t channel;
+  uint8_t len;
+  uint8_t payload[MUX_MAX_MESSAGE];
+};
+
+static WiFiServer server(STREAM_PORT);
+static WiFiClient client;
+static QueueHandle_t upstreamQueue = nullptr;
+
+static volatile bool connected = false;
+static volatile StreamMode mode = MODE_DETECT;
+static volatile uint32_t bytesReceived = 0;
+static volatile uint16_t connectionCount = 0;
+
+static uint8_t readBuffer[NET_READ_CHUNK];
+static uint8_t magicBuffer[MUX_MAGIC_LEN];
+static size_t magicLen = 0;
+
+// Frame currently being received
+static FrameSlot* rxSlot = nullptr;
+static uint32_t rxSeq = 0;
+static bool rxOverflow = false;
+
+// Probe frame currently being received (counted, never stored)
+static bool rxProbe = false;
+static uint32_t probeSeq = 0;
+static uint32_t probeBytes = 0;
+static unsigned long probeStartUs = 0;
+
+// Raw MJPEG scanner, filling rxSlot from the primary frame queue
+static MjpegScanner rawScanner;
+
+// Mux packet parser state
+static uint8_t muxHeader[MUX_HEADER_SIZE];
+static size_t muxHeaderLen = 0;
+static uint8_t muxChannel = 0;
+static uint8_t muxFlags = 0;
+static size_t muxRemaining = 0;
+static uint8_t muxMessage[MUX_MAX_MESSAGE];
+static size_t muxMessageLen = 0;
+
+// Cursor state (reserved for pointer overlay)
+static volatile int16_t cursorX = 0;
+static volatile int16_t cursorY = 0;
+static volatile bool cursorVisible = false;
+
+static void writePacket(uint8_t channel, uint8_t flags, const uint8_t* payload, size_t len) {
+  uint8_t packet[MUX_HEADER_SIZE + MUX_MAX_MESSAGE];
+  if (len > MUX_MAX_MESSAGE) return;
+  packet[0] = channel;
+  packet[1] = flags;
+  putLE16(packet + 2, len);
+  memcpy(packet + MUX_HEADER_SIZE, payload, len);
+  client.write(packet, MUX_HEADER_SIZE + len);
+}
+
+static void queueUpstream(uint8_t channel, const uint8_t* payload, size_t len) {
+  if (mode != MODE_MUX || !upstreamQueue || len > MUX_MAX_MESSAGE) return;
+  UpstreamMessage msg;
+  msg.channel = channel;
+  msg.len = len;
+  memcpy(msg.payload, payload, len);
+  xQueueSend(upstreamQueue, &msg, 0);  // Drop if the link is backed up
+}
+
+static void drainUpstream() {
+  UpstreamMessage msg;
+  while (xQueueReceive(upstreamQueue, &msg, 0) == pdTRUE) {
+    writePacket(msg.channel, 0, msg.payload, msg.len);
+  }
+}
+
+static void submitReceivedFrame() {
+  relayFrame(rxSlot);  // Before the decoder can release it
+  submitFrameSlot(rxSlot);
+  rxSlot = nullptr;
+}
+
+// Raw MJPEG: frames are delimited by SOI (0xFFD8) and EOI (0xFFD9) markers
+static void rawFrame(FrameSlot* frame) {
+  frame->seq = ++rxSeq;
+  relayFrame(frame);  // Before the decoder can release it
+  submitFrameSlot(frame);
+}
+
+static void rawProcess() {
+  rxSlot = mjpegScan(&rawScanner, rxSlot);
+}
+
+static void handleMessage(uint8_t channel, const uint8_t* msg, size_t len) {
+  if (len == 0) return;
+
+  switch (channel) {
+    case MUX_CH_CONTROL:
+      if (msg[0] == CTRL_PING && len >= 9) {
+        // Answer straight from the network task to keep the round trip short
+        uint8_t pong[9];
+        memcpy(pong, msg, 9);
+        pong[0] = CTRL_PONG;
+        writePacket(MUX_CH_CONTROL, 0, pong, sizeof(pong));
+      } else if (msg[0] == CTRL_RELAY) {
+        relayConfigure(msg, len);
+      }
+      break;
+    case MUX_CH_CURSOR:
+      if (msg[0] == CURSOR_POS && len >= 6) {
+        cursorX = (int16_t)getLE16(msg + 1);
+        cursorY = (int16_t)getLE16(msg + 3);
+        cursorVisible = msg[5] != 0;
+      }
+      break;
+    default:
+      break;
+  }
+}
+
+static void requestRefreshNow() {
+  uint8_t msg[1] = {CTRL_REFRESH};
+  writePacket(MUX_CH_CONTROL, 0, msg, sizeof(msg));
+}
+
+static void beginVideoFrame() {
+  rxProbe = (muxFlags & MUX_FLAG_PROBE) != 0;
+  if (rxProbe) {
+    probeSeq = ++rxSeq;
+    probeBytes = 0;
+    probeStartUs = micros();
+    return;
+  }
+  if (!rxSlot) {
+    // Tiled frames are deltas, so losing one means the screen is stale
+    uint32_t dropped = framesDropped();
+    rxSlot = acquireFrameSlot();
+    if (framesDropped() != dropped && rxSlot->tiled) requestRefreshNow();
+  }
+  // Sequence numbers count frames started, matching the sender's count
+  rxSlot->size = 0;
+  rxSlot->seq = ++rxSeq;
+  rxSlot->tiled = (muxFlags & MUX_FLAG_TILED) != 0;
+  rxOverflow = false;
+}
+
+static void HOT_IRAM appendVideo(const uint8_t* data, size_t len) {
+  if (rxProbe) {
+    probeBytes += len;
+    return;
+  }
+  if (!rxSlot || rxOverflow) return;
+  if (rxSlot->size + len > frameSlotCapacity()) {
+    rxOverflow = true;
+    return;
+  }
+  memcpy(rxSlot->data + rxSlot->size, data, len);
+  rxSlot->size += len;
+}
+
+// Report probe goodput straight from the network task, like pongs, so the
+// answer does not wait for the decode loop
+static void endProbeFrame() {
+  rxProbe = false;
+  uint8_t msg[13];
+  msg[0] = TELEM_PROBE;
+  putLE32(msg + 1, probeSeq);
+  putLE32(msg + 5, probeBytes);
+  putLE32(msg + 9, micros() - probeStartUs);
+  writePacket(MUX_CH_TELEMETRY, 0, msg, sizeof(msg));
+}
+
+static void endVideoFrame() {
+  if (rxProbe) {
+    endProbeFrame();
+    return;
+  }
+  if (!rxSlot) return;
+  if (rxOverflow) {
+    Serial.println("Frame too large, dropped");
+    if (rxSlot->tiled) requestRefreshNow();
+    rxSlot->size = 0;
+    return;
+  }
+  if (rxSlot->size > 0) {
+    submitReceivedFrame();
+  }
+}
+
+static void muxPacketDone() {
+  muxHeaderLen = 0;
+  if (muxChannel == MUX_CH_VIDEO) {
+    if (muxFlags & MUX_FLAG_FRAME_END) endVideoFrame();
+  } else {
+    handleMessage(muxChannel, muxMessage, muxMessageLen);
+  }
+}
+
+static void HOT_IRAM muxFeed(const uint8_t* data, size_t len) {
+  while (len > 0) {
+    if (muxHeaderLen < MUX_HEADER_SIZE) {
+      muxHeader[muxHeaderLen++] = *data++;
+      len--;
+      if (muxHeaderLen == MUX_HEADER_SIZE) {
+        muxChannel = muxHeader[0];
+        muxFlags = muxHeader[1];
+        muxRemaining = getLE16(muxHeader + 2);
+        muxMessageLen = 0;
+        if (muxChannel == MUX_CH_VIDEO && (muxFlags & MUX_FLAG_FRAME_START)) {
+          beginVideoFrame();
+        }
+        if (muxRemaining == 0) muxPacketDone();
+      }
+      continue;
+    }
+
+    size_t n = min(len, muxRemaining);
+    if (muxChannel == MUX_CH_VIDEO) {
+      appendVideo(data, n);
+    } else {
+      size_t keep = min(n, MUX_MAX_MESSAGE - muxMessageLen);
+      memcpy(muxMessage + muxMessageLen, data, keep);
+      muxMessageLen += keep;
+    }
+    data += n;
+    len -= n;
+    muxRemaining -= n;
+    if (muxRemaining == 0) muxPacketDone();
+  }
+}
+
+static void onConnect() {
+  Serial.println("Client connected - MJPEG stream starting");
+  client.setNoDelay(true);
+  client.setTimeout(100);
+  mode = MODE_DETECT;
+  magicLen = 0;
+  muxHeaderLen = 0;
+  rxSeq = 0;
+  rxProbe = false;
+  mjpegScanReset(&rawScanner);
+  xQueueReset(upstreamQueue);
+  connectionCount++;
+  connected = true;
+}
+
+static void onDisconnect() {
+  Serial.println("Client disconnected");
+  connected = false;
+  if (rxSlot) {
+    releaseFrameSlot(rxSlot);
+    rxSlot = nullptr;
+  }
+  flushFrameQueue();
+}
+
+static void readStream(int available) {
+  if (mode == MODE_RAW) {
+    // Raw MJPEG is read straight into the frame slot
+    if (!rxSlot) rxSlot = acquireFrameSlot();
+    size_t space = frameSlotCapacity() - rxSlot->size;
+    int bytesRead = client.read(rxSlot->data + rxSlot->size, min((size_t)available, space));
+    if (bytesRead > 0) {
+      rxSlot->size += bytesRead;
+      bytesReceived += bytesRead;
+      rawProcess();
+    }
+    return;
+  }
+
+  int bytesRead = client.read(readBuffer, min((size_t)available, sizeof(readBuffer)));
+  if (bytesRead <= 0) return;
+  bytesReceived += bytesRead;
+
+  const uint8_t* data = readBuffer;
+  size_t len = bytesRead;
+
+  if (mode == MODE_DETECT) {
+    while (magicLen < MUX_MAGIC_LEN && len > 0) {
+      magicBuffer[magicLen++] = *data++;
+      len--;
+    }
+    if (magicLen < MUX_MAGIC_LEN) return;
+
+    if (memcmp(magicBuffer, MUX_MAGIC, MUX_MAGIC_LEN) == 0) {
+      Serial.println("Multiplexed stream detected");
+      mode = MODE_MUX;
+    } else {
+      mode = MODE_RAW;
+      if (!rxSlot) rxSlot = acquireFrameSlot();
+      memcpy(rxSlot->data, magicBuffer, MUX_MAGIC_LEN);
+      rxSlot->size = MUX_MAGIC_LEN;
+    }
+  }
+
+  if (mode == MODE_MUX) {
+    muxFeed(data, len);
+  } else {
+    memcpy(rxSlot->data + rxSlot->size, data, len);
+    rxSlot->size += len;
+    rawProcess();
+  }
+}
+
+bool acceptStreamClient(WiFiServer& server, WiFiClient& client, unsigned long* lastAcceptMs,
+                        unsigned long intervalMs) {
+  if (millis() - *lastAcceptMs < intervalMs) return false;
+  *lastAcceptMs = millis();
+  client = server.available();
+  return (bool)client;
+}
+
+// One bounded step of the receive side: accept, send queued messages and
+// process at most one socket read. Returns true if data was read.
+static bool serviceStream() {
+  if (!client || !client.connected()) {
+    if (connected) onDisconnect();
+    static unsigned long lastAccept = 0;
+    if (!acceptStreamClient(server, client, &lastAccept, ACCEPT_INTERVAL_MS)) return false;
+    onConnect();
+  }
+
+  drainUpstream();
+
+  int available = client.available();
+  if (available <= 0) return false;
+  readStream(available);
+  return true;
+}
+
+static void networkTask(void* arg) {
+  for (;;) {
+    if (!serviceStream()) {
+      vTaskDelay(1);  // Allow other tasks
+    }
+  }
+}
+
+bool beginStreamReceiver() {
+  upstreamQueue = xQueueCreate(UPSTREAM_QUEUE_LEN, sizeof(UpstreamMessage));
+  if (!upstreamQueue) return false;
+  rawScanner.pool = frameQueuePool();
+  rawScanner.sink = rawFrame;
+
+  server.begin();
+  server.setNoDelay(true);
+  Serial.printf("MJPEG server listening on port %d\n", STREAM_PORT);
+
+#if STREAM_COOPERATIVE
+  // Polled from the decode loop through pollStreamReceiver()
+  return true;
+#else
+  return xTaskCreatePinnedToCore(networkTask, "stream_rx", NET_TASK_STACK, nullptr,
+                                 NET_TASK_PRIORITY, nullptr, NET_TASK_CORE) == pdPASS;
+#endif
+}
+
+bool pollStreamReceiver() {
+  return serviceStream();
+}
+
+bool streamConnected() {
+  return connected;
+}
+
+bool streamIsMultiplexed() {
+  return mode == MODE_MUX;
+}
+
+uint32_t streamBytesReceived() {
+  return bytesReceived;
+}
+
+uint16_t streamConnectionCount() {
+  return connectionCount;
+}
+
+void sendDeviceStats(const DeviceStats* stats) {
+  uint8_t msg[33];
+  msg[0] = TELEM_STATS;
+  putLE16(msg + 1, stats->fpsX10);
+  putLE16(msg + 3, stats->kbps);
+  putLE32(msg + 5, stats->decodeP50Us);
+  putLE32(msg + 9, stats->decodeP90Us);
+  putLE32(msg + 13, stats->decodeP99Us);
+  putLE32(msg + 17, stats->framesDropped);
+  msg[21] = (uint8_t)stats->rssi;
+  msg[22] = stats->queueDepth;
+  putLE16(msg + 23, stats->reconnects);
+  putLE32(msg + 25, stats->framesDecoded);
+  putLE32(msg + 29, stats->uptimeS);
+  queueUpstream(MUX_CH_TELEMETRY, msg, sizeof(msg));
+}
+
+void sendFrameAck(uint32_t seq, uint32_t size, uint32_t queueUs, uint32_t decodeUs) {
+  uint8_t msg[17];
+  msg[0] = TELEM_FRAME_ACK;
+  putLE32(msg + 1, seq);
+  putLE32(msg + 5, size);
+  putLE32(msg + 9, queueUs);
+  putLE32(msg + 13, decodeUs);
+  queueUpstream(MUX_CH_TELEMETRY, msg, sizeof(msg));
+}
+
+void sendTileStats(uint32_t seq, const TileStats* stats) {
+  uint8_t msg[5 + TILE_CODEC_COUNT * 6];
+  msg[0] = TELEM_TILE_STATS;
+  putLE32(msg + 1, seq);
+  for (int i = 0; i < TILE_CODEC_COUNT; i++) {
+    putLE16(msg + 5 + i * 6, stats->tiles[i]);
+    putLE32(msg + 7 + i * 6, stats->decodeUs[i]);
+  }
+  queueUpstream(MUX_CH_TELEMETRY, msg, sizeof(msg));
+}
+
+void requestRefresh() {
+  uint8_t msg[1] = {CTRL_REFRESH};
+  queueUpstream(MUX_CH_CONTROL, msg, sizeof(msg));
+}
+
+void sendInputEvent(uint8_t button, bool pressed) {
+  uint8_t msg[3] = {INPUT_BUTTON, button, (uint8_t)(pressed ? 1 : 0)};
+  queueUpstream(MUX_CH_INPUT, msg, sizeof(msg));
+}
+
+bool streamCursor(int16_t* x, int16_t* y) {
+  *x = cursorX;
+  *y = cursorY;
+  return cursorVisible;
+}
@@ -0,0 +1,85 @@
+#include "tile_decoder.h"
+#include "frame_layout.h"
+#include "hot_path.h"
+
+// Pixel buffer for palette and raw tiles (internal RAM)
+static uint16_t tileBuffer[TILE_MAX_PIXELS];
+
+// Palette + run-length tile: runs of (length-1, palette index)
+static bool HOT_IRAM decodePaletteTile(const uint8_t* data, size_t len, uint16_t w, uint16_t h) {
+  if (len < 1) return false;
+  size_t colors = data[0] + 1;
+  if (len < 1 + colors * 2) return false;
+
+  uint16_t palette[256];
+  for (size_t i = 0; i < colors; i++) {
+    palette[i] = getLE16(data + 1 + i * 2);
+  }
+
+  size_t pixels = (size_t)w * h;
+  size_t pos = 0;
+  for (size_t i = 1 + colors * 2; i + 1 < len; i += 2) {
+    size_t run = data[i] + 1;
+    uint8_t index = data[i + 1];
+    if (index >= colors || pos + run > pixels) return false;
+    uint16_t color = palette[index];
+    for (size_t r = 0; r < run; r++) {
+      tileBuffer[pos++] = color;
+    }
+  }
+  return pos == pixels;
+}
+
+static bool decodeRawTile(const uint8_t* data, size_t len, uint16_t w, uint16_t h) {
+  size_t pixels = (size_t)w * h;
+  if (len != pixels * 2) return false;
+  memcpy(tileBuffer, data, len);  // Payload may be unaligned
+  return true;
+}
+
+JRESULT decodeTileFrame(const uint8_t* data, size_t len, TileStats* stats) {
+  memset(stats, 0, sizeof(TileStats));
+  if (len < 2) return JDR_INP;
+
+  uint16_t count = getLE16(data);
+  size_t pos = 2;
+  JRESULT result = JDR_OK;
+
+  for (uint16_t t = 0; t < count; t++) {
+    // pos never exceeds len, so len - pos cannot wrap; pos + size could
+    if (TILE_HEADER_SIZE > len - pos) return JDR_INP;
+    const uint8_t* hdr = data + pos;
+    uint8_t codec = hdr[0];
+    uint16_t x = getLE16(hdr + 1);
+    uint16_t y = getLE16(hdr + 3);
+    uint16_t w = getLE16(hdr + 5);
+    uint16_t h = getLE16(hdr + 7);
+    uint32_t size = getLE32(hdr + 9);
+    pos += TILE_HEADER_SIZE;
+    if (size > len - pos || codec >= TILE_CODEC_COUNT) return JDR_INP;
+
+    const uint8_t* payload = data + pos;
+    pos += size;
+    unsigned long start = micros();
+
+    if (codec == TILE_CODEC_JPEG) {
+      JRESULT res = TJpgDec.drawJpg(x, y, payload, size);
+      if (res != JDR_OK) result = res;
+    } else {
+      if ((size_t)w * h > TILE_MAX_PIXELS) return JDR_PAR;
+      bool ok = (codec == TILE_CODEC_PALETTE)
+        ? decodePaletteTile(payload, size, w, h)
+        : decodeRawTile(payload, size, w, h);
+      if (ok) {
+        drawDisplayBlock(x, y, tileBuffer, w, h);
+      } else {
+        result = JDR_FMT1;
+      }
+    }
+
+    stats->tiles[codec]++;
+    stats->decodeUs[codec] += micros() - start;
+  }
+
+  return result;
+}
@@ -1,7 +1,39 @@
 #include "wifi_config.h"
+#include "display_calibration.h"
 #include <lilka.h>
 #include <WiFi.h>
 #include <Preferences.h>
+#include <esp_wifi.h>
+
+// Direct-link state
+static bool directLink = false;
+static String apSSID, apPassword;
+
+// One access point from a scan, with the throughput it is expected to give
+struct AccessPoint {
+  String ssid;
+  String password;
+  uint8_t bssid[6];
+  int32_t channel;
+  int32_t rssi;
+  float expectedMbps;
+};
+
+// Roaming state
+static AccessPoint currentAP;
+static bool haveCurrentAP = false;
+static float baselineKbps = 0;
+static int lowSeconds = 0;
+static unsigned long lastRoamCheckMs = 0;
+static bool roamScanRunning = false;
+static AccessPoint roamTarget, roamPrevious;
+static bool roamHadPrevious = false;
+static unsigned long roamJoinStartMs = 0;  // Non-zero while joining roamTarget
+static float roamJoinKbps = 0;
+static String fallbackSSID, fallbackPassword;  // Keira's last network
+static float roamBeforeKbps = 0;
+static int roamReportSeconds = -1;  // Seconds measured since the last switch, -1 if none
+static uint32_t roamAfterKbps = 0;
 
 // Hash SSID to create storage key (matches Keira's implementation)
 String hashSSID(String ssid) {
@@ -41,11 +73,8 @@ bool loadWiFiCredentials(String& ssid, String& password) {
   return true;
 }
 
-bool connectToWiFi(String ssid, String password) {
-  Serial.printf("Connecting to WiFi: %s\n", ssid.c_str());
-  
-  lilka::Canvas canvas;
-  canvas.begin();
+// Two centred lines, e.g. "Connecting to WiFi..." and the SSID
+static void showWiFiStatus(lilka::Canvas& canvas, const char* title, const char* detail) {
   canvas.fillScreen(lilka::colors::Black);
   canvas.setTextColor(lilka::colors::White);
   canvas.setTextSize(1);
@@ -53,18 +82,29 @@ bool connectToWiFi(String ssid, String password) {
   int16_t x1, y1;
   uint16_t w, h;
   
-  canvas.getTextBounds("Connecting to WiFi...", 0, 0, &x1, &y1, &w, &h);
+  canvas.getTextBounds(title, 0, 0, &x1, &y1, &w, &h);
   canvas.setCursor((canvas.width() - w) / 2, (canvas.height() / 2) - 10);
-  canvas.println("Connecting to WiFi...");
+  canvas.println(title);
   
-  canvas.getTextBounds(ssid.c_str(), 0, 0, &x1, &y1, &w, &h);
+  canvas.getTextBounds(detail, 0, 0, &x1, &y1, &w, &h);
   canvas.setCursor((canvas.width() - w) / 2, (canvas.height() / 2) + 10);
-  canvas.println(ssid);
+  canvas.println(detail);
   
   lilka::display.drawCanvas(&canvas);
+}
+
+bool connectToWiFi(String ssid, String password, const uint8_t* bssid, int32_t channel) {
+  Serial.printf("Connecting to WiFi: %s\n", ssid.c_str());
+  
+  lilka::Canvas canvas;
+  canvas.begin();
+  showWiFiStatus(canvas, "Connecting to WiFi...", ssid.c_str());
+  
+  int16_t x1, y1;
+  uint16_t w, h;
   
   WiFi.mode(WIFI_STA);
-  WiFi.begin(ssid.c_str(), password.c_str());
+  WiFi.begin(ssid.c_str(), password.c_str(), channel, bssid);
   
   vTaskDelay(1000 / portTICK_PERIOD_MS);
   int attempts = 0;
@@ -96,3 +136,280 @@ bool connectToWiFi(String ssid, String password) {
   
   return success;
 }
+
+// Generate the direct-link SSID and password once and keep them in NVS, so
+// the sender's saved network keeps working across restarts
+static void loadDirectLinkCredentials() {
+  Preferences prefs;
+  prefs.begin(SETTINGS_NAMESPACE, false);
+  apSSID = prefs.getString("ap_ssid", "");
+  apPassword = prefs.getString("ap_pw", "");
+  if (apSSID.isEmpty() || apPassword.length() < 8) {
+    uint8_t mac[6];
+    WiFi.macAddress(mac);
+    char ssid[16];
+    snprintf(ssid, sizeof(ssid), "Lilka-%02X%02X", mac[4], mac[5]);
+    apSSID = ssid;
+    // No look-alike characters: the password is typed from the screen
+    const char* alphabet = "abcdefghjkmnpqrstuvwxyz23456789";
+    apPassword = "";
+    for (int i = 0; i < 10; i++) {
+      apPassword += alphabet[esp_random() % strlen(alphabet)];
+    }
+    prefs.putString("ap_ssid", apSSID);
+    prefs.putString("ap_pw", apPassword);
+  }
+  prefs.end();
+}
+
+// How much an AP heard at this RSSI competes for airtime: 1 at -50 dBm or
+// louder, fading to almost nothing near the noise floor
+static float apWeight(int32_t rssi) {
+  return constrain((rssi + 100) / 50.0f, 0.02f, 1.0f);
+}
+
+// Interference per 2.4 GHz channel from the last scan, in AP-equivalents.
+// Each AP counts on its own channel and, fading out, on the four channels
+// either side that its 20 MHz overlaps.
+static void channelLoad(int found, float load[WIFI_MAX_CHANNEL + 1]) {
+  for (int c = 0; c <= WIFI_MAX_CHANNEL; c++) load[c] = 0;
+  for (int i = 0; i < found; i++) {
+    int channel = WiFi.channel(i);
+    float weight = apWeight(WiFi.RSSI(i));
+    for (int c = 1; c <= WIFI_MAX_CHANNEL; c++) {
+      int distance = abs(c - channel);
+      if (distance < 5) load[c] += weight * (5 - distance) / 5.0f;
+    }
+  }
+}
+
+// Scan and return the channel (1-11) with the least interference
+static int pickQuietChannel() {
+  WiFi.mode(WIFI_STA);
+  int found = WiFi.scanNetworks(false, true, false, 120);
+  float load[WIFI_MAX_CHANNEL + 1];
+  channelLoad(found, load);
+  WiFi.scanDelete();
+
+  // The non-overlapping channels win ties
+  static const int order[] = {1, 6, 11, 2, 3, 4, 5, 7, 8, 9, 10};
+  int best = order[0];
+  for (int c : order) {
+    if (load[c] < load[best]) best = c;
+  }
+  Serial.printf("Direct link: %d APs in range, channel load", found > 0 ? found : 0);
+  for (int c = 1; c <= DIRECT_LINK_MAX_CHANNEL; c++) {
+    Serial.printf(" %d:%.1f", c, load[c]);
+  }
+  Serial.printf(" -> channel %d\n", best);
+  return best;
+}
+
+bool startDirectLink() {
+  lilka::Canvas canvas;
+  canvas.begin();
+  showWiFiStatus(canvas, "Starting direct link...", "Scanning channels");
+
+  loadDirectLinkCredentials();
+  int channel = pickQuietChannel();
+  WiFi.mode(WIFI_AP);
+  if (!WiFi.softAP(apSSID.c_str(), apPassword.c_str(), channel)) {
+    Serial.println("Direct link: failed to start the access point");
+    return false;
+  }
+  // A 40 MHz channel would spill onto the neighbours the scan avoided
+  esp_wifi_set_bandwidth(WIFI_IF_AP, WIFI_BW_HT20);
+  directLink = true;
+  Serial.printf("Direct link: SSID %s, password %s, channel %d, IP %s\n", apSSID.c_str(),
+                apPassword.c_str(), channel, WiFi.softAPIP().toString().c_str());
+  return true;
+}
+
+bool directLinkActive() {
+  return directLink;
+}
+
+String directLinkSSID() {
+  return apSSID;
+}
+
+String directLinkPassword() {
+  return apPassword;
+}
+
+IPAddress linkIP() {
+  return directLink ? WiFi.softAPIP() : WiFi.localIP();
+}
+
+int8_t linkRSSI() {
+  if (!directLink) return WiFi.RSSI();
+  wifi_sta_list_t stations;
+  if (esp_wifi_ap_get_sta_list(&stations) != ESP_OK || stations.num == 0) return 0;
+  return stations.sta[0].rssi;
+}
+
+// Typical 802.11n HT20 rate (Mbit/s) an ESP32 gets at an RSSI, from the
+// receiver sensitivity of each MCS
+static float phyRateMbps(int32_t rssi) {
+  static const struct {
+    int8_t rssi;
+    uint8_t mbps;
+  } steps[] = {{-64, 65}, {-65, 58}, {-66, 52}, {-70, 39}, {-74, 26}, {-77, 19}, {-79, 13}, {-82, 6}};
+  for (const auto& step : steps) {
+    if (rssi >= step.rssi) return step.mbps;
+  }
+  return 1;
+}
+
+// The rate is shared with every other AP heard on overlapping channels
+static float expectedMbps(int32_t rssi, int32_t channel, const float load[WIFI_MAX_CHANNEL + 1]) {
+  float others = channel >= 1 && channel <= WIFI_MAX_CHANNEL ? load[channel] - apWeight(rssi) : 0;
+  return phyRateMbps(rssi) / (1.0f + max(others, 0.0f));
+}
+
+// Pick the scanned AP of any network saved in Keira with the highest
+// expected throughput. Keira keeps a password per network under the hash of
+// its SSID, so saved networks are found by looking up scanned SSIDs.
+static bool pickBestAP(int found, AccessPoint* best) {
+  float load[WIFI_MAX_CHANNEL + 1];
+  channelLoad(found, load);
+  Preferences prefs;
+  if (!prefs.begin(WIFI_NAMESPACE, true)) return false;
+  bool any = false;
+  for (int i = 0; i < found; i++) {
+    String ssid = WiFi.SSID(i);
+    String key = hashSSID(ssid) + "_pw";
+    if (ssid.isEmpty() || !prefs.isKey(key.c_str())) continue;
+    float mbps = expectedMbps(WiFi.RSSI(i), WiFi.channel(i), load);
+    Serial.printf("WiFi: %s %s ch %d %d dBm, expected %.1f Mbit/s\n", ssid.c_str(),
+                  WiFi.BSSIDstr(i).c_str(), WiFi.channel(i), WiFi.RSSI(i), mbps);
+    if (any && mbps <= best->expectedMbps) continue;
+    best->ssid = ssid;
+    best->password = prefs.getString(key.c_str(), "");
+    memcpy(best->bssid, WiFi.BSSID(i), 6);
+    best->channel = WiFi.channel(i);
+    best->rssi = WiFi.RSSI(i);
+    best->expectedMbps = mbps;
+    any = true;
+  }
+  prefs.end();
+  return any;
+}
+
+bool connectToBestWiFi(String ssid, String password) {
+  fallbackSSID = ssid;
+  fallbackPassword = password;
+  WiFi.mode(WIFI_STA);
+  int found = WiFi.scanNetworks(false, false, false, 120);
+  AccessPoint best;
+  bool picked = found > 0 && pickBestAP(found, &best);
+  WiFi.scanDelete();
+  if (picked) {
+    Serial.printf("WiFi: joining %s %02x:%02x:%02x:%02x:%02x:%02x on channel %d\n", best.ssid.c_str(),
+                  best.bssid[0], best.bssid[1], best.bssid[2], best.bssid[3], best.bssid[4],
+                  best.bssid[5], best.channel);
+    if (connectToWiFi(best.ssid, best.password, best.bssid, best.channel)) {
+      currentAP = best;
+      haveCurrentAP = true;
+      return true;
+    }
+  }
+  // Hidden networks never show up in a scan
+  return connectToWiFi(ssid, password);
+}
+
+// Scan results of the roaming check: switch if another AP promises clearly
+// more than the current one
+static void finishRoamScan(int found, float currentKbps) {
+  AccessPoint best;
+  bool picked = found > 0 && pickBestAP(found, &best);
+  float load[WIFI_MAX_CHANNEL + 1];
+  channelLoad(found, load);
+  float currentMbps = expectedMbps(WiFi.RSSI(), WiFi.channel(), load);
+  WiFi.scanDelete();
+  if (!picked || memcmp(best.bssid, WiFi.BSSID(), 6) == 0 ||
+      best.expectedMbps < currentMbps * ROAM_MIN_GAIN) {
+    Serial.printf("Roam: staying on %s (%d dBm, expected %.1f Mbit/s)\n", WiFi.BSSIDstr().c_str(),
+                  WiFi.RSSI(), currentMbps);
+    baselineKbps = currentKbps;  // Nothing better in range: this is the new normal
+    return;
+  }
+
+  Serial.printf("Roam: %.0f kbps (baseline %.0f) on %s ch %d %d dBm, expected %.1f Mbit/s"
+                " -> %s ch %d %d dBm, expected %.1f Mbit/s\n",
+                currentKbps, baselineKbps, WiFi.BSSIDstr().c_str(), WiFi.channel(), WiFi.RSSI(),
+                currentMbps, best.ssid.c_str(), best.channel, best.rssi, best.expectedMbps);
+  // The join completes in the background; pollWiFiRoaming() follows it
+  roamTarget = best;
+  roamPrevious = currentAP;
+  roamHadPrevious = haveCurrentAP;
+  roamJoinKbps = currentKbps;
+  roamJoinStartMs = max(millis(), 1UL);
+  WiFi.disconnect();
+  WiFi.begin(best.ssid.c_str(), best.password.c_str(), best.channel, best.bssid);
+}
+
+void pollWiFiRoaming() {
+  if (!roamJoinStartMs) return;
+  unsigned long elapsed = millis() - roamJoinStartMs;
+  if (WiFi.status() == WL_CONNECTED) {
+    roamJoinStartMs = 0;
+    currentAP = roamTarget;
+    haveCurrentAP = true;
+    roamBeforeKbps = roamJoinKbps;
+    roamReportSeconds = 0;
+    roamAfterKbps = 0;
+    baselineKbps = 0;
+    Serial.printf("Roam: joined in %lu ms, IP %s\n", elapsed, WiFi.localIP().toString().c_str());
+  } else if (elapsed >= ROAM_JOIN_TIMEOUT_MS) {
+    roamJoinStartMs = 0;
+    WiFi.disconnect();
+    if (roamHadPrevious) {
+      Serial.println("Roam: join failed, returning to the previous AP");
+      WiFi.begin(roamPrevious.ssid.c_str(), roamPrevious.password.c_str(), roamPrevious.channel,
+                 roamPrevious.bssid);
+    } else {
+      // Joined by SSID at startup (e.g. hidden): let the driver pick again
+      Serial.println("Roam: join failed, returning to Keira's network");
+      WiFi.begin(fallbackSSID.c_str(), fallbackPassword.c_str());
+    }
+  }
+}
+
+void updateWiFiRoaming(uint32_t kbps) {
+  if (directLink || roamJoinStartMs || WiFi.status() != WL_CONNECTED) return;
+
+  if (roamScanRunning) {
+    int found = WiFi.scanComplete();
+    if (found == WIFI_SCAN_RUNNING) return;
+    roamScanRunning = false;
+    lowSeconds = 0;
+    if (found >= 0) finishRoamScan(found, kbps);
+    return;
+  }
+
+  if (roamReportSeconds >= 0) {
+    roamAfterKbps += kbps;
+    if (++roamReportSeconds == ROAM_WINDOW_S) {
+      Serial.printf("Roam: %.0f kbps before the switch, %u kbps after\n", roamBeforeKbps,
+                    roamAfterKbps / ROAM_WINDOW_S);
+      roamReportSeconds = -1;
+    }
+  }
+
+  // A link that is still strong is not why the stream slowed down: the
+  // sender may simply be sending less, e.g. unchanged tiles
+  bool low = baselineKbps >= ROAM_MIN_BASELINE_KBPS &&
+             kbps < baselineKbps * ROAM_DROP_PERCENT / 100 && WiFi.RSSI() < ROAM_RSSI_DBM;
+  if (!low) {
+    lowSeconds = 0;
+    baselineKbps = baselineKbps ? baselineKbps * 0.9f + kbps * 0.1f : kbps;
+    return;
+  }
+  if (++lowSeconds < ROAM_WINDOW_S || millis() - lastRoamCheckMs < ROAM_COOLDOWN_MS) return;
+
+  Serial.printf("Roam: %u kbps for %d s against a %.0f kbps baseline at %d dBm, scanning\n", kbps,
+                lowSeconds, baselineKbps, WiFi.RSSI());
+  lastRoamCheckMs = millis();
+  roamScanRunning = WiFi.scanNetworks(true, false, false, 120) == WIFI_SCAN_RUNNING;
+}
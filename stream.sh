@@ -5,6 +5,10 @@
 #
 # Usage: ./stream.sh <ESP32_IP> [PORT] [FPS] [QUALITY]
 #
+# By default frames are piped through host/lilka_sender.py, which multiplexes
+# video with control/telemetry channels. Set RAW=1 to send plain MJPEG with
+# tcpclientsink instead.
+#
 
 set -e
 
@@ -14,6 +18,39 @@ PORT="${2:-8090}"
 FPS="${3:-15}"
 QUALITY="${4:-50}"
 
+# Send plain MJPEG without the multiplexing sender
+RAW="${RAW:-0}"
+# Let the sender pick a codec per tile (needs python3-numpy and python3-pil)
+TILES="${TILES:-0}"
+# Simulcast JPEG qualities, e.g. LAYERS=30,50,80 or LAYERS=30@140x120,50,80 with a
+# half-resolution layer (needs python3-numpy and python3-pil)
+LAYERS="${LAYERS:-}"
+# Probe the link at connect to pick FPS and QUALITY when they are not given
+PROBE="${PROBE:-1}"
+# Video pacing: off, frame (spread each frame over the frame interval) or kbps
+PACE="${PACE:-off}"
+# Stream an MJPEG camera instead of the screen: a V4L2 device (/dev/video0) or
+# an IP camera's multipart MJPEG URL (needs python3-pil)
+CAMERA="${CAMERA:-}"
+# Encode scene cuts cheaply and recover over the next frames: quality or
+# resolution (sends raw frames to the sender, like TILES=1)
+SCENE_CUT="${SCENE_CUT:-}"
+# Temporal denoise strength 1-3 for noisy cameras (frames are then re-encoded)
+DENOISE="${DENOISE:-}"
+# Join a Lilka's own access point before streaming: DIRECT="Lilka-1A2B:password"
+# as shown on its screen (Linux, NetworkManager); the Lilka is then 192.168.4.1
+DIRECT="${DIRECT:-}"
+# Send every receiver's copy of a frame from one shared buffer (Linux MSG_ZEROCOPY)
+ZEROCOPY="${ZEROCOPY:-0}"
+
+# Several receivers can be given as a comma-separated list
+IFS=, read -ra HOSTS <<< "$IP"
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+SEND_ARGS=()
+if [ "$ZEROCOPY" = "1" ]; then
+    SEND_ARGS=(--zerocopy)
+fi
+
 # Display dimensions for Lilka v2
 WIDTH=280
 HEIGHT=240
@@ -29,9 +66,23 @@ if [ -z "$1" ]; then
     echo "  FPS        - Frames per second (default: 15)"
     echo "  QUALITY    - JPEG quality 1-100 (default: 50)"
     echo ""
+    echo "Environment:"
+    echo "  RAW=1      - Send plain MJPEG via tcpclientsink (no multiplexing)"
+    echo "  TILES=1    - Per-tile codec selection in the sender (numpy, Pillow)"
+    echo "  LAYERS=q,q - Simulcast qualities; each receiver gets the best it sustains"
+    echo "  PROBE=0    - Skip the connect-time probe that picks FPS and QUALITY"
+    echo "  PACE=frame - Pace video instead of sending each frame in one burst"
+    echo "  CAMERA=dev - MJPEG webcam (/dev/video0) or IP camera URL instead of the screen"
+    echo "  SCENE_CUT=quality - Lower quality (or resolution) on scene cuts, then recover"
+    echo "  DENOISE=2  - With CAMERA: temporal denoise strength 1-3 before encoding"
+    echo "  ZEROCOPY=1 - Share one frame buffer between receivers, sent with MSG_ZEROCOPY"
+    echo "  DIRECT=ssid:password - Join the Lilka's direct-link access point first"
+    echo ""
     echo "Examples:"
     echo "  $0 192.168.1.100"
     echo "  $0 192.168.1.100 8090 20 60"
+    echo "  LAYERS=30,50,80 $0 192.168.1.100,192.168.1.101"
+    echo "  DIRECT=Lilka-1A2B:password $0 192.168.4.1"
     echo ""
     echo "GStreamer plugins required:"
     echo "  Linux:  gstreamer1.0-plugins-good (ximagesrc)"
@@ -39,12 +90,50 @@ if [ -z "$1" ]; then
     exit 1
 fi
 
+if [ -n "$DIRECT" ]; then
+    echo "Joining direct link ${DIRECT%%:*}..."
+    nmcli device wifi connect "${DIRECT%%:*}" password "${DIRECT#*:}"
+fi
+
+if [ "$RAW" != "1" ] && [ "$PROBE" = "1" ] && [ -z "$3" ] && [ -z "$4" ]; then
+    echo "Probing link and decoder..."
+    if PROBED=$(python3 "$SCRIPT_DIR/host/lilka_sender.py" "${HOSTS[@]}" --port "$PORT" \
+            --probe-only --size "${WIDTH}x${HEIGHT}"); then
+        eval "$PROBED"
+    fi
+fi
+
 echo "=== MJPEG Stream Transmitter ==="
 echo "Target: $IP:$PORT"
 echo "Resolution: ${WIDTH}x${HEIGHT}"
 echo "FPS: $FPS, Quality: $QUALITY"
 echo ""
 
+# Camera MJPEG is not decoded here: the sender passes frames that fit the
+# display through and scales larger ones in the DCT domain
+if [ -n "$CAMERA" ]; then
+    if [[ "$CAMERA" == http* ]]; then
+        SOURCE="souphttpsrc location=$CAMERA is-live=true ! multipartdemux ! image/jpeg"
+    else
+        SOURCE="v4l2src device=$CAMERA ! image/jpeg"
+    fi
+    DENOISE_ARGS=()
+    if [ -n "$DENOISE" ]; then
+        DENOISE_ARGS=(--denoise "$DENOISE")
+    fi
+    echo "Streaming camera $CAMERA (Ctrl+C to stop)"
+    gst-launch-1.0 -q -e \
+        $SOURCE \
+        ! queue max-size-buffers=2 leaky=downstream \
+        ! videorate drop-only=true \
+        ! "image/jpeg,framerate=$FPS/1" \
+        ! fdsink fd=1 \
+        | python3 "$SCRIPT_DIR/host/lilka_sender.py" "${HOSTS[@]}" --port "$PORT" \
+            --source camera --size "${WIDTH}x${HEIGHT}" --fps "$FPS" --quality "$QUALITY" --pace "$PACE" \
+            "${DENOISE_ARGS[@]}" "${SEND_ARGS[@]}"
+    exit $?
+fi
+
 # Detect platform and set appropriate screen capture element
 if [[ "$OSTYPE" == "linux-gnu"* ]]; then
     # Linux - try different capture methods
@@ -85,9 +174,52 @@ echo ""
 # 5. Limit framerate
 # 6. Encode as baseline JPEG (not progressive, compatible with TJpgDec)
 # 7. Add queue before network sink
-# 8. Send over TCP
+# 8. Send over TCP (raw) or pipe to the multiplexing sender
+
+if [ "$RAW" = "1" ]; then
+    exec gst-launch-1.0 -e \
+        $CAPTURE \
+        ! queue max-size-buffers=2 leaky=downstream \
+        ! videoscale method=lanczos \
+        ! "video/x-raw,width=$WIDTH,height=$HEIGHT" \
+        ! videorate \
+        ! "video/x-raw,framerate=$FPS/1" \
+        ! videoconvert \
+        ! "video/x-raw,format=I420" \
+        ! jpegenc quality=$QUALITY idct-method=ifast \
+        ! queue max-size-buffers=2 leaky=downstream \
+        ! tcpclientsink host=${HOSTS[0]} port=$PORT
+fi
+
+if [ "$TILES" = "1" ] || [ -n "$LAYERS" ] || [ -n "$SCENE_CUT" ]; then
+    if [ "$TILES" = "1" ]; then
+        ENCODER_ARGS=(--tiles --quality "$QUALITY")
+    elif [ -n "$LAYERS" ]; then
+        ENCODER_ARGS=(--layers "$LAYERS")
+    else
+        ENCODER_ARGS=(--quality "$QUALITY")
+    fi
+    if [ -n "$SCENE_CUT" ]; then
+        ENCODER_ARGS+=(--scene-cut "$SCENE_CUT")
+    fi
+    gst-launch-1.0 -q -e \
+        $CAPTURE \
+        ! queue max-size-buffers=2 leaky=downstream \
+        ! videoscale method=lanczos \
+        ! "video/x-raw,width=$WIDTH,height=$HEIGHT" \
+        ! videorate \
+        ! "video/x-raw,framerate=$FPS/1" \
+        ! videoconvert \
+        ! "video/x-raw,format=RGB" \
+        ! queue max-size-buffers=2 leaky=downstream \
+        ! fdsink fd=1 \
+        | python3 "$SCRIPT_DIR/host/lilka_sender.py" "${HOSTS[@]}" --port "$PORT" \
+            --source raw --size "${WIDTH}x${HEIGHT}" --fps "$FPS" --pace "$PACE" "${ENCODER_ARGS[@]}" \
+            "${SEND_ARGS[@]}"
+    exit $?
+fi
 
-exec gst-launch-1.0 -e \
+gst-launch-1.0 -q -e \
     $CAPTURE \
     ! queue max-size-buffers=2 leaky=downstream \
     ! videoscale method=lanczos \
@@ -98,4 +230,6 @@ exec gst-launch-1.0 -e \
     ! "video/x-raw,format=I420" \
     ! jpegenc quality=$QUALITY idct-method=ifast \
     ! queue max-size-buffers=2 leaky=downstream \
-    ! tcpclientsink host=$IP port=$PORT
+    ! fdsink fd=1 \
+    | python3 "$SCRIPT_DIR/host/lilka_sender.py" "${HOSTS[@]}" --port "$PORT" --pace "$PACE" \
+        "${SEND_ARGS[@]}"
@@ -0,0 +1,100 @@
+// Cooperative scheduler on the host (pio test -e native), with a simulated
+// clock: receive steps take RX_STEP_US, a frame decodes in DECODE_ROWS rows
+// of ROW_US and yields after each row, like the TJpgDec output callback.
+
+#include <Arduino.h>
+#include <unity.h>
+#include "coop_scheduler.h"
+
+#define RX_STEP_US  50
+#define ROW_US      2000
+#define DECODE_ROWS 15
+
+static unsigned long nowUs = 0;
+
+unsigned long micros() {
+  return nowUs;
+}
+
+static int rxRuns = 0;
+static int decodeDepth = 0;
+static int maxDecodeDepth = 0;
+static int decodeRuns = 0;
+static bool frameReady = false;
+static bool rxDeliversFrames = false;  // Every receive step completes a frame
+
+static bool rxStep() {
+  nowUs += RX_STEP_US;
+  rxRuns++;
+  if (rxDeliversFrames) frameReady = true;
+  return true;
+}
+
+static bool decodeStep() {
+  if (!frameReady) return false;
+  frameReady = false;
+  decodeRuns++;
+  decodeDepth++;
+  maxDecodeDepth = max(maxDecodeDepth, decodeDepth);
+  for (int row = 0; row < DECODE_ROWS; row++) {
+    nowUs += ROW_US;
+    coopYield();
+  }
+  decodeDepth--;
+  return true;
+}
+
+void setUp() {
+  rxRuns = 0;
+  decodeRuns = 0;
+  maxDecodeDepth = 0;
+  frameReady = false;
+  rxDeliversFrames = false;
+}
+
+void tearDown() {}
+
+// Without yields receive would wait a whole decode (30 ms); with them it
+// waits about one row
+static void test_rx_gap_bounded_by_a_row() {
+  coopRunOnce();
+  coopTakeMaxGap("rx");
+  for (int frame = 0; frame < 5; frame++) {
+    frameReady = true;
+    coopRunOnce();
+  }
+  TEST_ASSERT_GREATER_OR_EQUAL(5 * DECODE_ROWS, rxRuns);
+  TEST_ASSERT_LESS_OR_EQUAL(ROW_US + RX_STEP_US, coopTakeMaxGap("rx"));
+}
+
+// A yield from inside the decode runs receive but never the decode itself:
+// frames that arrive mid-decode wait for the next run
+static void test_no_reentry() {
+  rxDeliversFrames = true;
+  for (int run = 0; run < 5; run++) coopRunOnce();
+  TEST_ASSERT_EQUAL(5, decodeRuns);
+  TEST_ASSERT_EQUAL(1, maxDecodeDepth);
+}
+
+// Yields closer together than COOP_MIN_SLICE_US return without running steps
+static void test_yield_within_slice_runs_nothing() {
+  coopRunOnce();
+  rxRuns = 0;
+  nowUs += COOP_MIN_SLICE_US - RX_STEP_US - 1;
+  coopYield();
+  TEST_ASSERT_EQUAL(0, rxRuns);
+  nowUs += RX_STEP_US + 1;
+  coopYield();
+  TEST_ASSERT_EQUAL(1, rxRuns);
+}
+
+int main() {
+  coopAdd("rx", rxStep);
+  coopAdd("decode", decodeStep);
+
+  UNITY_BEGIN();
+  RUN_TEST(test_rx_gap_bounded_by_a_row);
+  RUN_TEST(test_no_reentry);
+  RUN_TEST(test_yield_within_slice_runs_nothing);
+  return UNITY_END();
+}